@@ -166,6 +166,10 @@
 594	597	Scanfreq1: 10
 */
 
+//600:605: S-Meter calibration offset per band (dB + 64)
+//606: CAT baud rate, index into baud_rate[] (0 = 2400 ... 6 = 115200 Bd)
+//607: CAT mode (0 = native, 1 = Kenwood)
+
 #include <inttypes.h>
 #include <string.h>
 #include <stdio.h>
@@ -175,13 +179,71 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/sleep.h>
+#include <avr/wdt.h>
 #include <util/delay.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
 #include <avr/eeprom.h>
 
 #define FOSC 16000000// Clock Speed
-#define BAUD 2400
-#define UARTBAUDSET FOSC/16/BAUD-1
-#define MAXRXBUFLEN 24
+#define MAXRXBUFLEN 64          //Several ';' separated commands per line
+#define CAT_ECHO_LEN (LCD_WIDTH / FONTWIDTH) //Chars of a line shown on the display
+#define CAT_MAXTOK 5            //Verb, noun and up to 3 arguments
+#define CAT_MAXARG 3
+#define CAT_NOUNLEN 8           //Longest noun ("SIDEBAND")
+#define CAT_NUM 0               //Argument types: Number lo...hi
+#define CAT_RESET 1             //                Keyword "RESET"
+#define CAT_STREAM 2            //                Stream name, passed as index
+#define CAT_LINES 1             //Flags: Reply of several lines
+#define CAT_MENU 2              //       Executed while a menu is open (CAT_LOCK_SET)
+#define CAT_FMAX 30000000       //Highest frequency (VFO, LO, memories) accepted by CAT
+#define CAT_MODE_ADR 607        //EEPROM: CAT personality
+#define CAT_NATIVE 0            //SET/GET lines, CR terminated
+#define CAT_KENWOOD 1           //Additionally Kenwood TS-480 commands, ';' terminated (hamlib)
+#define KW_SM_MS 50             //Kenwood SM reply is reused for this time
+
+//Streams: Values pushed to the host when they change, "SET STREAM [name] [updates/s]"
+//Only the latest value is sent, at most [updates/s] times and only while the TX buffer is half empty
+#define STREAMS 6
+#define STREAM_FREQ 0
+#define STREAM_BAND 1
+#define STREAM_VFO 2
+#define STREAM_SIDEBAND 3
+#define STREAM_PTT 4
+#define STREAM_SMETER 5         //dBm
+#define STREAM_RATE_MAX 50
+
+//Binary CAT frames, detected by SYNC at start of a line:
+//SYNC LEN SEQ OPS[LEN] CRC_HI CRC_LO, CRC16-CCITT (0x1021, start 0xFFFF) over LEN, SEQ and OPS
+//Op: Item (GET) or item | CATB_SET followed by value (big endian, size of item)
+//Reply frame with same SEQ holds op, status and current value for every op of the request,
+//an unknown or incomplete op is answered by CATB_NAK and its offset in OPS, nothing is executed.
+//A frame with CRC error is answered by CATB_NAK CATB_NAK_CRC, the host repeats it.
+//EEPROM block transfer uses a whole frame for one chunk, see catb_eeprom().
+#define CATB_SYNC 0xA5
+#define CATB_MAXLEN 35          //Max. bytes of OPS (EEPROM write: op, address, 32 bytes)
+#define CATB_TIMEOUT 100        //ms between two bytes of a frame
+#define CATB_SET 0x80
+#define CATB_NAK 0xFF
+#define CATB_NAK_CRC 0xFF       //Offset reported for CRC error
+#define CATB_EE_READ 0x40       //EEPROM chunk ops, alone in a frame
+#define CATB_EE_WRITE 0x41
+#define CATB_EE_CHUNK 32        //Max. bytes per chunk
+#define CATB_FREQ 0             //Items, value size in catb_items[]
+#define CATB_SIDEBAND 1
+#define CATB_VFO 2
+#define CATB_ATT 3
+#define CATB_SMETER 4           //dBm, read only
+#define CATB_BAND 5
+#define CATB_TONE 6
+#define CATB_AGC 7
+#define CATB_ITEMS 8
+#define CATB_OK 0               //Status of op
+#define CATB_RANGE 1
+#define CATB_REJECT 2           //Value not taken, e. g. frequency outside of band or modal screen open
+#define UART_RX_LEN 64          //Ring buffer sizes, power of 2 (max. 256)
+#define UART_TX_LEN 128
+#define UART_TX_WAIT 1000       //Max. wait for room in full TX buffer, 10us steps (2 chars @ 2400 Bd)
 
   ///////////////////
  //  LCD-Display  //
@@ -253,6 +315,9 @@
 #define FONTWIDTH  12 
 #define FONTHEIGHT 16
 
+//Main frequency display: 100 Hz resolution, "29700.0"
+#define FREQ1_WIDTH 7
+
 //Font data 12x16 vert. MSB 
 //Based on work by Benedikt K. published on
 //https://www.mikrocontroller.net/topic/54860 THANKS!
@@ -394,6 +459,20 @@ int bcolor = BLACK0; //Standard Background Color
  //  ADC  //
 ////////////
 #define ADC_KEY_PORT PORTF
+#define ADC_CHANNELS 5 //ADC0:ADC4 are scanned in background
+
+//Key engine (timing in samples of ADC0, i.e. 10ms)
+#define KEY_T_DEBOUNCE 3  //Level has to be stable for this number of samples
+#define KEY_T_LONG 80     //Hold time for long press event
+#define KEY_T_REPEAT 15   //Interval of repeat events after long press
+#define KEY_QUEUE_LEN 8   //Event queue size (power of 2)
+//Event codes (upper nibble) ORed with key number 1..3 (lower nibble)
+#define KEY_EV_PRESS   0x10
+#define KEY_EV_RELEASE 0x20
+#define KEY_EV_LONG    0x30
+#define KEY_EV_REPEAT  0x40
+#define KEY_EVENT(ev) ((ev) & 0xF0)
+#define KEY_NUM(ev) ((ev) & 0x0F)
 
   ///////////
  //  DDS  //
@@ -426,9 +505,166 @@ int bcolor = BLACK0; //Standard Background Color
 //S-Meter
 #define SMAX 240
 #define SMETERPOSITION 62
+#define SMETER_CH 4             //AGC voltage on ADC4
+#define SMETER_OVERSAMPLE 16    //Conversions per meter sample (16 = 2 extra bits)
+#define SMETER_ATTACK_SHIFT 1   //Attack time constant = 2^n meter samples
+#define SMETER_DECAY_SHIFT 5    //Decay time constant = 2^n meter samples
+#define SMETER_S9_DBM -73       //S9 level and its position on the bar scale
+#define SMETER_S9_X 108
+#define SMETER_CAL_ADR 600      //EEPROM: Calibration offset per band
+
+//CAT baud rate, selected by SET BAUD and stored as table index
+//U2X mode throughout: Every normal mode rate can also be set with U2X, so the rounded U2X divisor has the lowest error
+//Error @16MHz: 2400..4800 < 0.1%, 9600..38400 +0.16%, 57600 -0.8%, 115200 +2.1%
+#define BAUD_ADR 606            //EEPROM: Index into baud_rate[]
+#define BAUD_RATES 7
+#define BAUD_DEFAULT 0          //2400 Bd
+#define BAUD_CONFIRM_MS 5000    //New rate is kept only if a valid command arrives within this time
+#define UBRR_U2X(b) ((FOSC + 4UL * (b)) / (8UL * (b)) - 1)
+const unsigned long baud_rate[BAUD_RATES] PROGMEM = {2400, 4800, 9600, 19200, 38400, 57600, 115200};
+const unsigned int baud_ubrr[BAUD_RATES] PROGMEM = {UBRR_U2X(2400), UBRR_U2X(4800), UBRR_U2X(9600), UBRR_U2X(19200),
+	                                                UBRR_U2X(38400), UBRR_U2X(57600), UBRR_U2X(115200)};
+
+//AGC voltage (ADC4, 10 bit in steps of 64) -> dBm, calibration offset per band is added
+const signed char smeter_dbm_tab[17] PROGMEM = {-56, -61, -65, -70, -76, -85, -94, -103, -112, -121, -127, -127, -127, -127, -127, -127, -127};
+
+//Tuning acceleration
+#define ENC_TIMER_HZ 250000UL   //Timer1 counting rate (16MHz / 64), free running
+#define KNOB_MAX 8              //Max. detents queued by encoder ISR
+#define ENC_IDLE_MS 200         //Knob is regarded as resting after this time without an edge (< Timer1 wrap of 262ms)
+#define ENC_EMA_SHIFT 2         //Weight of new velocity sample = 1 / 2^ENC_EMA_SHIFT
+#define ENC_VEL_MAX 1000        //Clamp for instantaneous velocity (edges/s)
+#define TUNE_STEP_MAX 10000     //Upper bound for tuning step (Hz)
+#define TUNE_ACCEL_POINTS 9
+
+//Acceleration curve: Min. encoder velocity (edges/s) -> tuning step (Hz)
+//Steps are multiples of each other so the frequency stays on a clean grid
+const unsigned int tune_accel[TUNE_ACCEL_POINTS][2] PROGMEM = {{0, 10}, {25, 20}, {40, 50}, {55, 100}, {70, 500}, {90, 1000}, {110, 2000}, {130, 5000}, {150, TUNE_STEP_MAX}};
+
+//Software timers (callbacks are run from main loop)
+#define TIMER_MAX 8
+#define T_METER 200             //S-Meter / PWR meter update (ms)
+#define T_PEAK 2000             //Reset of meter peak value
+#define T_MSG 10000             //Message line hold time
+#define T_TEMP 10000            //PA temperature display
+#define T_VOLTS 5000            //Supply voltage display
+#define T_WARM 50               //Snapshot of radio state for warm restart
+
+//Scheduler
+#define TASK_MAX 6
+#define T1_US 4                 //Timer1: us per count
+#define T1_WRAP_MS 250          //Longer run times can't be measured with Timer1
+
+//Background service while a modal screen waits for input
+#define UI_SRV_CAT 1            //Parse CAT commands
+#define UI_SRV_PTT 2            //Switch TX by PTT (not on screens that key the TX themselves)
+#define UI_SRV_CAT_SET 4        //CAT may also change settings (only screens that show none of them)
+#define UI_SRV_ALL (UI_SRV_CAT | UI_SRV_PTT)
+#define CAT_LOCK_SET 1          //cat_locked: Menu open, CAT may only switch PTT and set the frequency (CAT_MENU)
+#define CAT_LOCK_ALL 2          //            Screen keys the TX or tunes by itself, no changes at all
+
+//Profiler: Min/max/avg. run time of code sections by Timer1 (64 cycles per count)
+//Set PROF_ENABLE to 1 to build it in, "GET PROF" reports, "SET PROF RESET" clears
+#define PROF_ENABLE 0
+#define PROF_DDS1 0             //DDS1 (VFO) frequency word calculation and transfer
+#define PROF_DDS2 1             //DDS2 (LO)
+#define PROF_FREQ 2             //Frequency redraw
+#define PROF_METER 3            //S-Meter / PWR bar
+#define PROF_ADC 4              //ADC conversion ISR
+#define PROF_CAT 5              //CAT command parse and execution
+#define PROF_EEPROM 6           //EEPROM byte write incl. wait for the previous one
+#define PROF_LOOP 7             //Scheduler pass (main loop iteration)
+#define PROF_SECTIONS 8
+
+#if PROF_ENABLE
+#define PROF_START(s) prof_t0[s] = TCNT1
+#define PROF_STOP(s) prof_add(s, TCNT1 - prof_t0[s])
+#else
+#define PROF_START(s)
+#define PROF_STOP(s)
+#endif
+
+//Event trace (flight recorder), ring buffer of the last TRACE_LEN events
+#define TRACE_LEN 32            //Power of 2
+#define TR_TX 1                 //TX relay: Bit 0 = on/off, bits 8..15 = source
+#define TR_BAND 2               //Band number, bit 8 = switched while TX
+#define TR_VFO 3                //VFO number, bit 8 = switched while TX
+#define TR_SIDEBAND 4           //0 = LSB, 1 = USB
+#define TR_DDS1 5               //VFO frequency (Hz)
+#define TR_DDS2 6               //LO frequency (Hz)
+#define TR_CAT 7                //Command line received: chars 0, 4, 5, 6 (e. g. "SFRE" = SET FREQ)
+#define TR_UART_OVR 8           //UART receiver overrun, number of overruns so far
+#define TR_EEPROM 9             //EEPROM write: Address (bits 16..31), value (bits 0..15)
+#define TR_EEPROM_FREQ 10       //Frequency written to EEPROM by store_frequency1() (Hz)
+#define TR_TX_PTT 0x000         //TR_TX sources
+#define TR_TX_CAT 0x100
+#define TR_TX_LOCAL 0x200       //TX test, tune, TX preset
+#define TRACE_EEPROM(adr, val) trace_put(TR_EEPROM, ((unsigned long) (adr) << 16) | ((val) & 0xFFFF))
+
+//Scratch memory for short lived buffers (replaces heap)
+#define SCRATCH_SIZE 96
+#define SCRATCH_SPILL 32        //Max. size of a single request
+
+//Stack check: Free RAM is filled with STACK_CANARY before main(), GET STACK reports untouched bytes
+#define STACK_CANARY 0xC5
+
+//Watchdog and warm restart: Radio state is kept in .noinit RAM and restored after a watchdog reset
+#define WDT_TIMEOUT WDTO_2S     //Longer than the longest blocking wait (1s message delays)
+#define WARM_MAGIC 0x5741
+#define TWI_TIMEOUT 1000        //Polls of TWINT, approx. 0.5ms (1 byte @ 400kHz = 23us)
+#define EEPROM_TIMEOUT 2000     //10us steps, 20ms (1 byte write = 8.5ms)
+
+//PA temperature sensor (ADC2): KTY type, R(T) = TEMP_R0 + TEMP_SLOPE * T, against TEMP_R_SERIES to VREF
+#define TEMP_R_SERIES 2000.0
+#define TEMP_R0 1630.0
+#define TEMP_SLOPE 17.62
+#define TEMP_MIN -400           //Display range (1/10 deg. C)
+#define TEMP_MAX 1500
+#define TEMP_LUT_SHIFT 3        //Table step = 8 ADC codes
+
+//Temperature in 1/100 deg. C for an ADC code, evaluated by the compiler only
+#define TEMP100_RAW(a) (100.0 * (TEMP_R_SERIES * (a) / (1024.0 - (a)) - TEMP_R0) / TEMP_SLOPE)
+#define TEMP100(a) ((a) >= 1024 || TEMP100_RAW(a) > 32000 ? 32000 : (int) TEMP100_RAW(a))
+#define TEMP_LUT_ROW(a) TEMP100(a), TEMP100(a + 8), TEMP100(a + 16), TEMP100(a + 24), TEMP100(a + 32), TEMP100(a + 40), TEMP100(a + 48), TEMP100(a + 56)
+
+//ADC code -> temperature (1/100 deg. C), linear interpolation between entries
+const int temp_lut[(1024 >> TEMP_LUT_SHIFT) + 1] PROGMEM = {TEMP_LUT_ROW(0), TEMP_LUT_ROW(64), TEMP_LUT_ROW(128), TEMP_LUT_ROW(192),
+	                                                       TEMP_LUT_ROW(256), TEMP_LUT_ROW(320), TEMP_LUT_ROW(384), TEMP_LUT_ROW(448),
+	                                                       TEMP_LUT_ROW(512), TEMP_LUT_ROW(576), TEMP_LUT_ROW(640), TEMP_LUT_ROW(704),
+	                                                       TEMP_LUT_ROW(768), TEMP_LUT_ROW(832), TEMP_LUT_ROW(896), TEMP_LUT_ROW(960), TEMP100(1024)};
+
+//Powers of ten for number to string conversion by subtraction
+const unsigned long dec_pow10[10] PROGMEM = {1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10, 1};
+
+//Supply voltage (ADC3): 5V reference, 1:5 divider -> 1/10 V = ADC * VDD_SCALE / 1024
+#define VDD_VREF 5
+#define VDD_DIVIDER 5
+#define VDD_SCALE (VDD_VREF * VDD_DIVIDER * 10)
 
 int main(void);
 
+//Stack check
+extern uint8_t _end;    //End of .bss (no heap in use, stack grows down to here)
+extern uint8_t __stack; //Top of RAM
+#ifdef __AVR__ //Host test build has no startup sections
+void stack_paint(void) __attribute__ ((naked, used, section (".init1")));
+#endif
+unsigned int stack_free(void);
+
+//Watchdog and warm restart
+void init_delay(int);
+unsigned int warm_sum(void);
+void warm_save(void);
+void warm_timer(void);
+int warm_resume(void);
+void load_start_values(void);
+int eeprom_wait(void);
+void eeprom_store(unsigned int, unsigned char);
+
+//Scratch memory
+char *scratch_alloc(int);
+void scratch_release(char*);
+
   /////////////////
  //   L  C  D   //
 /////////////////
@@ -440,6 +676,7 @@ void lcd_cls(int);
 void lcd_draw_pixel(int);
 void lcd_putchar(int, int, int, int, int, int);
 void lcd_putstring(int, int, char*, int, int, int);
+void lcd_putstring_P(int, int, PGM_P, int, int, int);
 void lcd_putnumber(int, int, long, int, int, int, int);
 void lcd_init(void);
 void lcd_setbacklight(int);
@@ -466,10 +703,11 @@ void reset_smax(void);
 void smeter(int, int);
 void clear_smeter(int);
 void show_msg(char*, int);
+void show_msg_P(PGM_P, int);
 //STRING FUNCTIONS
 int int2asc(long, int, char*, int);
-long asc2long(char*);
-void get_info_from_string(char*, char*, int);
+int int2asc_fixed(long, int, char*, int);
+int parse_long(char*, long*);
 
 //int strlen(char *s);
 int calcx(int col);
@@ -490,12 +728,144 @@ void set_frequency2(long fx);
 void set_lo_freq(int);
 //ADC
 int get_s_value(void);
+int get_s_dbm(void);
+void smeter_load_cal(void);
+void smeter_store_cal(int, int);
 int get_keys(void);
+int key_decode(int);
+void key_sample(int);
+void key_put(unsigned char);
+int key_get_event(void);
+int key_get_press(void);
+int ui_get_key(int);
+void ui_restore(void);
 int get_adc(int);
+int get_temp10(void);
+int get_volts10(void);
 int get_ptt(void);
+unsigned long get_ms(void);
+int knob_get(void);
+void knob_ack(int);
+void knob_clear(void);
+int timer_start(void (*)(void), unsigned int, unsigned int);
+void timer_restart(int, unsigned int);
+void timer_stop(int);
+void timer_poll(void);
+void meter_timer(void);
+void peak_timer(void);
+void msg_timer(void);
+void temp_timer(void);
+void volts_timer(void);
+void sched_add(void (*)(void), int, unsigned int, unsigned int);
+void sched_exec(int);
+void sched_run(void);
+void sched_report(void);
+void sched_reset(void);
+void idle_sleep(void);
+void ptt_task(void);
+int split_vfo(int);
+void tune_task(void);
+void keys_task(void);
+void cat_task(void);
+int cat_tokenize(char*);
+void cat_exec(char*);
+struct cat_cmd;
+const struct cat_cmd *cat_find(char*);
+int cat_in_range(const struct cat_cmd*, int, long);
+int cat_refused(const struct cat_cmd*);
+void cat_error(PGM_P);
+void cat_send_num(long, int);
+void cat_eol(void);
+void cat_line(char*);
+void cat_get_all(long*);
+long catb_value(int);
+int catb_set(int, long);
+void catb_send(unsigned char);
+void catb_send_value(long, int);
+void catb_begin(int, unsigned char);
+void catb_end(void);
+void catb_exec(void);
+void catb_rx(int);
+void catb_eeprom(void);
+void kw_digits(char*, long, int);
+void kw_error(void);
+int kw_locked(int);
+void kw_freq(int, char*);
+void kw_ai(char*);
+void kw_fa(char*);
+void kw_fb(char*);
+void kw_fr(char*);
+void kw_ft(char*);
+void kw_id(char*);
+void kw_if(char*);
+void kw_md(char*);
+void kw_ps(char*);
+void kw_rx(char*);
+void kw_sm(char*);
+void kw_tx(char*);
+void kw_exec(char*);
+int stream_find(char*);
+long stream_value(int);
+void stream_task(void);
+void cat_set_stream(long*);
+void cat_get_stream(long*);
+void cat_set_catmode(long*);
+void cat_get_catmode(long*);
+//CAT command handlers, get checked arguments
+void cat_set_agcs(long*);
+void cat_set_att(long*);
+void cat_set_band(long*);
+void cat_set_baud(long*);
+void cat_set_eeprom(long*);
+void cat_set_freq(long*);
+void cat_set_losc(long*);
+void cat_set_mem(long*);
+void cat_set_smcal(long*);
+void cat_set_prof(long*);
+void cat_set_ptt(long*);
+void cat_set_sched(long*);
+void cat_set_sideband(long*);
+void cat_set_tone(long*);
+void cat_set_vfo(long*);
+void cat_get_agcs(long*);
+void cat_get_agcv(long*);
+void cat_get_att(long*);
+void cat_get_band(long*);
+void cat_get_baud(long*);
+void cat_get_eeprom(long*);
+void cat_get_freq(long*);
+void cat_get_losc(long*);
+void cat_get_mem(long*);
+void cat_get_memall(long*);
+void cat_get_prof(long*);
+void cat_get_reset(long*);
+void cat_get_sched(long*);
+void cat_get_scratch(long*);
+void cat_get_sideband(long*);
+void cat_get_sleep(long*);
+void cat_get_smcal(long*);
+void cat_get_stack(long*);
+void cat_get_temp(long*);
+void cat_get_tone(long*);
+void cat_get_trace(long*);
+void cat_get_uart(long*);
+void cat_get_vdd(long*);
+void cat_get_vfo(long*);
+void timer_task(void);
+#if PROF_ENABLE
+void prof_add(int, unsigned int);
+void prof_report(void);
+void prof_reset(void);
+#endif
+void trace_put(unsigned char, unsigned long);
+void trace_dump(void);
+void usart_sendhex(unsigned long, int);
+void adc_init(void);
+void adc_start_next(void);
 
 //MISC
 int calc_tuningfactor(void);
+long tune_step(long, int);
 void tx_test(void);
 void tune(void);
 void set_audio_tone_oscillator(int);
@@ -511,7 +881,7 @@ int menu0_get_xp(int);
 int menu0_get_yp(int);
 long menu0(long, int, int);
 long menu1(int, long, int, int);
-void print_menu_head(char*, int);
+void print_menu_head(PGM_P, int);
 void print_menu_item(int, int, int);
 void print_menu_item_list(int, int);
 int navigate_thru_item_list(int, int, int, int, int);
@@ -536,9 +906,9 @@ int adjustbacklight(void);
 
 //TWI - I�C
 void twi_init(void);
-void twi_start(void);
+int twi_start(void);
 void twi_stop(void);
-void twi_write(uint8_t);
+int twi_write(uint8_t);
 
 //DAC and TX preset
 void mcp4725_set_value(int);
@@ -563,24 +933,145 @@ void store_last_mem(int);
 int save_mem_freq(long, int);
 
 //MEM Data transfer
-void rcv_mem_frequencies(void);
-void txm_mem_frequencies(void);
+void mem_transfer(void);
 
 //Checking
 int is_mem_freq_ok(long,int);
 
 //UART
 void usart_init(int);
+void usart_set_baud(int);
+void usart_baud_check(int);
 int usart_receive(void);
 void usart_transmit(unsigned char);
+int usart_tx_free(void);
+int usart_flush(unsigned int);
 void usart_sendstring(char*);
+void usart_sendstring_P(PGM_P);
 void usart_send_crlf(void);
 
   /////////////
  //Variables//
 /////////////
-//Seconds counting
-long runseconds10 = 0; 
+//Millisecond timebase (Timer0)
+volatile unsigned long ms_ticks = 0;
+
+//Software timers
+void (*timer_cb[TIMER_MAX])(void);   //Callback, 0 = slot free
+unsigned long timer_due[TIMER_MAX];  //ms_ticks value of next expiry
+unsigned int timer_period[TIMER_MAX]; //0 = one-shot
+int tmr_msg = -1;                    //Message line timer, restarted when a message has to stay
+
+//Scheduler
+void (*task_fn[TASK_MAX])(void);
+int task_prio[TASK_MAX];
+unsigned int task_period[TASK_MAX];  //ms, 0 = every pass
+unsigned int task_budget[TASK_MAX];  //Timer1 counts
+unsigned long task_due[TASK_MAX];
+unsigned int task_wcet[TASK_MAX];    //Worst case run time, Timer1 counts
+unsigned int task_overrun[TASK_MAX]; //Number of budget violations
+unsigned int task_late[TASK_MAX];    //Max. start delay (ms)
+int task_cnt = 0;
+unsigned int sched_last = 0;         //Timer1 count at last pass
+unsigned long sched_last_ms = 0;
+unsigned int sched_loop_max = 0;     //Longest time between two passes, Timer1 counts
+unsigned long sleep_ms = 0;          //Time spent in idle sleep
+unsigned char sleep_acc = 0;         //Fraction of ms, Timer1 counts
+unsigned long sleep_since = 0;       //ms_ticks at start of accounting
+
+#if PROF_ENABLE
+//Profiler, counts in Timer1 units
+const char prof_name[PROF_SECTIONS][7] PROGMEM = {"DDS1", "DDS2", "FREQ", "METER", "ADC", "CAT", "EEPROM", "LOOP"};
+unsigned int prof_t0[PROF_SECTIONS];
+unsigned int prof_min[PROF_SECTIONS];
+unsigned int prof_max[PROF_SECTIONS];
+unsigned long prof_sum[PROF_SECTIONS];
+unsigned int prof_cnt[PROF_SECTIONS];
+#endif
+
+//Scratch memory
+char scratch[SCRATCH_SIZE];
+char scratch_spill[SCRATCH_SPILL];   //Fallback if arena is exhausted, used as a second stack
+int scratch_top = 0;                 //Bytes in use
+int scratch_hwm = 0;                 //High-water mark
+int scratch_spill_top = 0;
+int scratch_spill_hwm = 0;
+unsigned int scratch_overflow = 0;   //Requests served from spill buffer
+unsigned int scratch_fail = 0;       //Requests that fit nowhere, buffer overlaps others (bug)
+
+//Event trace
+volatile unsigned int trace_ms[TRACE_LEN];   //Time stamp, low 16 bits of ms_ticks
+volatile unsigned char trace_ev[TRACE_LEN];
+volatile unsigned long trace_arg[TRACE_LEN];
+volatile unsigned char trace_head = 0;       //Next entry to write
+volatile unsigned char trace_cnt = 0;        //Number of valid entries
+
+//UART ring buffers, one producer and one consumer each, so no locking needed for 8 bit indices
+volatile unsigned char uart_rx_buf[UART_RX_LEN];
+volatile unsigned char uart_rx_head = 0;     //Written by RX ISR
+volatile unsigned char uart_rx_tail = 0;     //Written by main
+volatile unsigned char uart_tx_buf[UART_TX_LEN];
+volatile unsigned char uart_tx_head = 0;     //Written by main
+volatile unsigned char uart_tx_tail = 0;     //Written by UDRE ISR
+volatile unsigned char uart_tx_sent = 0;     //At least one byte went to UDR0 (TXC is valid)
+volatile unsigned int uart_overruns = 0;     //Receiver hardware overruns
+volatile unsigned int uart_rx_lost = 0;      //RX ring buffer full
+unsigned int uart_tx_lost = 0;               //TX ring buffer full for more than UART_TX_WAIT
+int memall_pos = -1;                         //Next memory of paced GET MEMALL output, -1 = idle
+int baud_idx = BAUD_DEFAULT;                 //Current CAT baud rate
+int baud_prev = -1;                          //Rate to fall back to if the new one is not confirmed, -1 = none
+unsigned long baud_t0;                       //Time of switch
+
+//Radio state kept over a watchdog reset (not cleared by C runtime)
+struct warm_state
+{
+	unsigned int magic;
+	unsigned int resets;             //Watchdog resets since last power-up
+	int band, vfo, sideband, split, memplace;
+	int vfo_s[2];
+	long f_vfo[2];
+	long f_lo[2];
+	int tone, agc, att, blight;
+	int s_threshold;
+	long scanfreq[2];
+	int tx_preset[6];
+	unsigned int sum;                //Must be last
+};
+struct warm_state warm __attribute__ ((section (".noinit")));
+unsigned char reset_cause;           //MCUCSR at power-up
+int warm_ok = 0;                     //Started from a valid warm state
+unsigned int twi_errors = 0;         //TWI transfers aborted by timeout
+unsigned int eeprom_timeouts = 0;
+
+//Main loop state
+int cur_vfo = 0, alt_vfo = 1;
+int k2_armed = 0;                    //K2 press seen by keys_task() (not by a menu), release or long press not yet handled
+long freq_temp1 = 0;                 //Memory frequency shown on main screen
+
+//CAT interface (+1 for terminating 0 of a full line)
+char buf1[MAXRXBUFLEN + 1];
+int cat_cnt = 0;
+int cat_ovf = 0;            //Line longer than MAXRXBUFLEN, refused as a whole
+char *cat_tok[CAT_MAXTOK];  //Tokens of buf1 after cat_tokenize()
+unsigned char catb_buf[CATB_MAXLEN + 4]; //Binary frame without SYNC
+int catb_cnt = -1;                       //Bytes of binary frame received, -1 = text mode
+unsigned long catb_t0;                   //ms of last byte received
+unsigned int catb_txcrc;                 //CRC of reply frame
+unsigned int catb_crc_errors = 0;
+unsigned int catb_ee_chunks = 0;         //EEPROM chunks transferred
+int cat_mode = CAT_NATIVE;
+int cat_batch = 0;                       //Executing a line of several commands
+int cat_quiet = 0;                       //Reply in progress (binary frame, line of several commands): No notifications
+int cat_locked = 0;                      //Modal screen is open: CAT_LOCK_SET or CAT_LOCK_ALL
+char kw_if_buf[39];                      //Cached Kenwood IF reply and the state it was built from
+long kw_if_f = -1;
+int kw_if_state = -1;
+char kw_sm_buf[9];                       //Cached Kenwood SM reply
+unsigned long kw_sm_t;
+unsigned char stream_rate[STREAMS];      //Max. updates/s, 0 = off
+unsigned int stream_ms[STREAMS];         //Min. interval
+unsigned long stream_t[STREAMS];         //Time and value of last push
+long stream_v[STREAMS];
 
 //S-Meter temporary max. value
 int smaxold = 0;
@@ -658,8 +1149,10 @@ long scanfreq[2];
 
 //Encoder & tuning
 int laststate = 0; //Last state of rotary encoder
-int tuningknob = 0;
-int tuningcount = 0;
+volatile int tuningknob = 0;             //Detents not handled yet (+CW, -CCW), use knob_get() etc. outside of ISR
+volatile unsigned int enc_last_tcnt = 0;  //Timer1 count at last encoder edge
+volatile unsigned long enc_last_ms = 0;   //ms_ticks at last encoder edge
+volatile unsigned int enc_velocity = 0;   //EMA filtered encoder velocity (1/16 edges/s)
 
 //Tone and AGC
 int cur_tone;
@@ -669,9 +1162,30 @@ int cur_att;
 //TX amplifier preset values
 int tx_preset[6] = {0, 0, 0, 0, 0, 0};
 
+//ADC scanner
+//Scan period (ms) and IIR filter weight (1/2^n) per channel: Keys, PWR, Temp, Voltage, S-Meter
+const unsigned char adc_period[ADC_CHANNELS] PROGMEM = {10, 20, 250, 250, 5};
+const unsigned char adc_filter[ADC_CHANNELS] PROGMEM = {0, 1, 3, 3, 0};
+volatile unsigned int adc_val[ADC_CHANNELS];  //Latest filtered value per channel
+volatile unsigned int adc_acc[ADC_CHANNELS];  //Filter accumulators (value * 16)
+volatile unsigned char adc_due[ADC_CHANNELS]; //ms until channel is due again
+volatile unsigned char adc_ch = 0;            //Channel currently converted
+volatile unsigned char adc_discard = 0;       //1st conversion after mux switch is thrown away
+volatile unsigned char adc_busy = 0;
+
+//S-Meter pipeline
+volatile unsigned int sm_sum = 0;  //Sum of oversampled conversions
+volatile unsigned char sm_n = 0;   //Number of conversions in sum
+volatile unsigned int sm_acc = 0;  //Attack/decay filtered 12 bit code * 8
+signed char smeter_cal[6] = {0, 0, 0, 0, 0, 0};
+
+//Key event queue (written by ADC ISR, read by main)
+volatile unsigned char key_queue[KEY_QUEUE_LEN];
+volatile unsigned char key_q_head = 0;
+volatile unsigned char key_q_tail = 0;
+
 //METER
 int smax = 0;
-long runseconds10s = 0;
 
 //Menu n=items-1
 int menu_items[MENUITEMS] =  {5, 1, 3, 1, 3, 3, 1, 3, 2, 1, 5}; 
@@ -679,12 +1193,118 @@ int menu_items[MENUITEMS] =  {5, 1, 3, 1, 3, 3, 1, 3, 2, 1, 5};
 //Backlight
 int blight = 128;
 
+//Display output suppressed (background tasks running under a modal screen)
+int lcd_mute = 0;
+
+//Main frequency as shown on screen, only changed digits are redrawn ("" = redraw all)
+char freq1_shown[FREQ1_WIDTH + 1];
+int freq1_x0 = 0, freq1_fc = 0;
+
+//CAT commands, sorted by name (verb S/G + noun) for binary search in cat_exec()
+struct cat_cmd
+{
+	char name[CAT_NOUNLEN + 2];
+	void (*fn)(long*);                //Handler
+	unsigned char args;               //Number of arguments
+	unsigned char type[CAT_MAXARG];   //CAT_NUM or CAT_RESET
+	long lo[CAT_MAXARG];              //Range of CAT_NUM arguments
+	long hi[CAT_MAXARG];
+	unsigned char flags;              //CAT_LINES (refused within a line of several commands), CAT_MENU
+};
+
+const struct cat_cmd cat_cmds[] PROGMEM =
+{
+	{"GAGCS",     cat_get_agcs,       0, {0}, {0}, {0}},
+	{"GAGCV",     cat_get_agcv,       0, {0}, {0}, {0}},
+	{"GALL",      cat_get_all,        0, {0}, {0}, {0}},
+	{"GATT",      cat_get_att,        0, {0}, {0}, {0}},
+	{"GBAND",     cat_get_band,       0, {0}, {0}, {0}},
+	{"GBAUD",     cat_get_baud,       0, {0}, {0}, {0}},
+	{"GCATMODE",  cat_get_catmode,    0, {0}, {0}, {0}},
+	{"GEEPROM",   cat_get_eeprom,     1, {CAT_NUM}, {0}, {E2END}},
+	{"GFREQ",     cat_get_freq,       0, {0}, {0}, {0}},
+	{"GLOSC",     cat_get_losc,       1, {CAT_NUM}, {0}, {1}},
+	{"GMEM",      cat_get_mem,        2, {CAT_NUM, CAT_NUM}, {0, 0}, {5, MAXMEM}},
+	{"GMEMALL",   cat_get_memall,     0, {0}, {0}, {0}, CAT_LINES},
+#if PROF_ENABLE
+	{"GPROF",     cat_get_prof,       0, {0}, {0}, {0}, CAT_LINES},
+#endif
+	{"GRESET",    cat_get_reset,      0, {0}, {0}, {0}},
+	{"GSCHED",    cat_get_sched,      0, {0}, {0}, {0}, CAT_LINES},
+	{"GSCRATCH",  cat_get_scratch,    0, {0}, {0}, {0}},
+	{"GSIDEBAND", cat_get_sideband,   0, {0}, {0}, {0}},
+	{"GSLEEP",    cat_get_sleep,      0, {0}, {0}, {0}},
+	{"GSMCAL",    cat_get_smcal,      1, {CAT_NUM}, {0}, {5}},
+	{"GSTACK",    cat_get_stack,      0, {0}, {0}, {0}},
+	{"GSTREAM",   cat_get_stream,     0, {0}, {0}, {0}},
+	{"GTEMP",     cat_get_temp,       0, {0}, {0}, {0}},
+	{"GTONE",     cat_get_tone,       0, {0}, {0}, {0}},
+	{"GTRACE",    cat_get_trace,      0, {0}, {0}, {0}, CAT_LINES},
+	{"GUART",     cat_get_uart,       0, {0}, {0}, {0}},
+	{"GVDD",      cat_get_vdd,        0, {0}, {0}, {0}},
+	{"GVFO",      cat_get_vfo,        0, {0}, {0}, {0}},
+	{"SAGCS",     cat_set_agcs,       1, {CAT_NUM}, {0}, {3}},
+	{"SATT",      cat_set_att,        1, {CAT_NUM}, {0}, {1}},
+	{"SBAND",     cat_set_band,       1, {CAT_NUM}, {0}, {5}},
+	{"SBAUD",     cat_set_baud,       1, {CAT_NUM}, {2400}, {115200}},
+	{"SCATMODE",  cat_set_catmode,    1, {CAT_NUM}, {0}, {1}},
+	{"SEEPROM",   cat_set_eeprom,     2, {CAT_NUM, CAT_NUM}, {0, 0}, {E2END, 255}},
+	{"SFREQ",     cat_set_freq,       1, {CAT_NUM}, {0}, {CAT_FMAX}, CAT_MENU},
+	{"SLOSC",     cat_set_losc,       2, {CAT_NUM, CAT_NUM}, {0, 0}, {1, CAT_FMAX}},
+	{"SMEM",      cat_set_mem,        3, {CAT_NUM, CAT_NUM, CAT_NUM}, {0, 0, 0}, {5, MAXMEM, CAT_FMAX}},
+#if PROF_ENABLE
+	{"SPROF",     cat_set_prof,       1, {CAT_RESET}, {0}, {0}},
+#endif
+	{"SPTT",      cat_set_ptt,        1, {CAT_NUM}, {0}, {1}, CAT_MENU},
+	{"SSCHED",    cat_set_sched,      1, {CAT_RESET}, {0}, {0}},
+	{"SSIDEBAND", cat_set_sideband,   1, {CAT_NUM}, {0}, {1}},
+	{"SSMCAL",    cat_set_smcal,      2, {CAT_NUM, CAT_NUM}, {0, -40}, {5, 40}},
+	{"SSTREAM",   cat_set_stream,     2, {CAT_STREAM, CAT_NUM}, {0, 0}, {0, STREAM_RATE_MAX}},
+	{"STONE",     cat_set_tone,       1, {CAT_NUM}, {0}, {3}},
+	{"SVFO",      cat_set_vfo,        1, {CAT_NUM}, {0}, {1}},
+};
+#define CAT_CMDS (sizeof(cat_cmds) / sizeof(cat_cmds[0]))
+
+//Stream names, index = STREAM_x
+const char stream_name[STREAMS][CAT_NOUNLEN + 1] PROGMEM = {"FREQ", "BAND", "VFO", "SIDEBAND", "PTT", "SMETER"};
+
+//Binary CAT items: Value size (bytes) and text command used to set it ("" = read only)
+struct catb_item
+{
+	unsigned char size;
+	char name[CAT_NOUNLEN + 2];
+};
+
+//Kenwood commands, sorted for binary search in kw_exec()
+struct kw_cmd
+{
+	char name[3];
+	void (*fn)(char*);                //Handler, gets parameters ("" = read)
+};
+
+const struct kw_cmd kw_cmds[] PROGMEM =
+{
+	{"AI", kw_ai}, {"FA", kw_fa}, {"FB", kw_fb}, {"FR", kw_fr}, {"FT", kw_ft}, {"ID", kw_id},
+	{"IF", kw_if}, {"MD", kw_md}, {"PS", kw_ps}, {"RX", kw_rx}, {"SM", kw_sm}, {"TX", kw_tx}
+};
+#define KW_CMDS (sizeof(kw_cmds) / sizeof(kw_cmds[0]))
+
+const struct catb_item catb_items[CATB_ITEMS] PROGMEM =
+{
+	{4, "SFREQ"}, {1, "SSIDEBAND"}, {1, "SVFO"}, {1, "SATT"}, {2, ""}, {1, "SBAND"}, {1, "STONE"}, {1, "SAGCS"}
+};
+
   /////////////////////////////////////
  //  Functions for ILI9341 control  //
 /////////////////////////////////////
 //Parallel write data or command to LCD
 void lcd_send(int dc, int val)
 {		
+	if(lcd_mute)
+	{
+		return;
+	}
+	
 	if(!dc) //Cmd (0) or Data(1)?
 	{
 	    LCDCTRLPORT &= ~(LCDRS);  //Cmd=0
@@ -841,6 +1461,7 @@ void lcd_cls(int bcolor)
 			lcd_draw_pixel(bcolor);
 		}	
 	}
+	freq1_shown[0] = 0;
 }		
 
 //Write character from font set to destination on screen
@@ -893,6 +1514,18 @@ void lcd_putstring(int x, int y, char *text, int size, int fc, int bc)
 	}
 }		
 
+//Print string from flash to LCD
+void lcd_putstring_P(int x, int y, PGM_P text, int size, int fc, int bc)
+{
+	char ch;
+	
+	while((ch = pgm_read_byte(text++)))
+	{
+		lcd_putchar(x, y, ch, size, fc, bc);
+		x += (size * FONTWIDTH);
+	}
+}		
+
 //Convert a number to a string and print it
 //col, row: Coordinates, Num: int or long to be displayed
 //dec: Set position of decimal separator
@@ -900,17 +1533,11 @@ void lcd_putstring(int x, int y, char *text, int size, int fc, int bc)
 //inv: Set to 1 if inverted charactor is required
 void lcd_putnumber(int x, int y, long num, int dec, int lsize, int fc, int bc)
 {
-    char *s = malloc(16);
-	if(s != NULL)
-	{
-	    int2asc(num, dec, s, 16);
-	    lcd_putstring(x, y, s, lsize, fc, bc);
-	    free(s);
-	}	
-	else
-	{
-		lcd_putstring(x, y, "Error", lsize, fc, bc);
-	}	
+    char *s = scratch_alloc(16);
+    
+    int2asc(num, dec, s, 16);
+    lcd_putstring(x, y, s, lsize, fc, bc);
+    scratch_release(s);
 }
 
 //Set backlight
@@ -999,39 +1626,48 @@ void show_frequency1(long f, int refresh, int bc)
 				lcd_draw_pixel(bc);
 			}	
 		}
-		//lcd_putstring(calcx(x0), calcy(y0), "#####.#",  2, YELLOW, bcolor);
+		//lcd_putstring_P(calcx(x0), calcy(y0), PSTR("#####.#"),  2, YELLOW, bcolor);
+		freq1_shown[0] = 0;
 		return;
 	}
-		
-	buf = malloc(10);
-	
-	//Init buffer string
-	for(t1 = 0; t1 < 10; t1++)
-	{
-	    *(buf + t1) = 0;
-	}
 	
-	if(f)
+	//Nothing is drawn while muted, so screen and cache would differ
+	if(refresh || lcd_mute || x0 != freq1_x0 || fc != freq1_fc)
 	{
-	    int2asc(f / 100, 1, buf, 9);
-	}
-	else
+		freq1_shown[0] = 0;
+	}	
+	if(lcd_mute)
 	{
-		for(t1 = 0; t1 < 8; t1++)
-		{
-			buf[t1] = 32;
-		}
-	}		
+		return;
+	}	
+	
+	PROF_START(PROF_FREQ);
+		
+	buf = scratch_alloc(FREQ1_WIDTH + 1);
+	
+	int2asc_fixed(f / 100, 1, buf, (x0 == 7) ? FREQ1_WIDTH : FREQ1_WIDTH - 1);
 	
 	//Display buffer (but only the letters that have changed)
 	for(t1 = 0; *(buf + t1); t1++)
 	{
-		lcd_putchar(calcx(x0 + t1 * 2), calcy(y0), *(buf + t1), 2, fc, bc);  
+		if(!freq1_shown[0] || buf[t1] != freq1_shown[t1])
+		{
+		    lcd_putchar(calcx(x0 + t1 * 2), calcy(y0), *(buf + t1), 2, fc, bc);  
+		}
 	}	
 	
-	lcd_putstring(calcx(22), calcy(8), "kHz", 1, fc, bc);
+	if(!freq1_shown[0])
+	{
+	    lcd_putstring_P(calcx(22), calcy(8), PSTR("kHz"), 1, fc, bc);
+	}
+	
+	strcpy(freq1_shown, buf);
+	freq1_x0 = x0;
+	freq1_fc = fc;
 		
-	free(buf);
+	scratch_release(buf);
+	
+	PROF_STOP(PROF_FREQ);
 }
 
 //Memeory frequency on selection memplace in menu
@@ -1041,22 +1677,22 @@ void show_frequency2(int x, int y, long f, int bc, int x10, int digits)
 		
 	if(!f)
 	{
-		lcd_putstring(calcx(x), calcy(y) - 1, "-------", 1, fcolor, bc);
+		lcd_putstring_P(calcx(x), calcy(y) - 1, PSTR("-------"), 1, fcolor, bc);
 	}
 	else
 	{	
-        lcd_putstring(calcx(x), calcy(y) - 1, "       ", 1, fcolor, bc);
+        lcd_putstring_P(calcx(x), calcy(y) - 1, PSTR("       "), 1, fcolor, bc);
 	    lcd_putnumber(calcx(x), calcy(y) - 1, f / x10, digits, 1, fcolor, bc);
 	}    
 }	
 
 void show_band(int b)
 {
-	char *bnd[] = {"160m", "80m ", "40m ", "20m ", "15m ", "10m"};
+	static const char bnd[6][5] PROGMEM = {"160m", "80m ", "40m ", "20m ", "15m ", "10m"};
 	
 	int xpos = 0, ypos = 8;
 	int fc[] = {LIGHT_GREEN, LIGHT_BLUE, LIGHT_BROWN, YELLOW, LIGHT_GRAY, LIGHT_VIOLET};
-	lcd_putstring(calcx(xpos), calcy(ypos)- 5, bnd[b], 1, fc[b], bcolor);	
+	lcd_putstring_P(calcx(xpos), calcy(ypos)- 5, bnd[b], 1, fc[b], bcolor);	
 }	
 
 //VFO
@@ -1064,7 +1700,7 @@ void show_vfo(int nvfo, int bcolor)
 {
 	int xpos = 0, ypos = 1;
 	
-	lcd_putstring(calcx(xpos), calcy(ypos), "VFO", 1, LIGHT_GRAY, bcolor);			
+	lcd_putstring_P(calcx(xpos), calcy(ypos), PSTR("VFO"), 1, LIGHT_GRAY, bcolor);			
 	lcd_putchar(calcx(xpos + 3), calcy(ypos), nvfo + 65, 1, LIGHT_GRAY, bcolor);  
 	
 }
@@ -1072,16 +1708,16 @@ void show_vfo(int nvfo, int bcolor)
 void show_split(int sp_status, int bcolor)
 {
 	int xpos = 0, ypos = 7;
-	char *splitstr = "SPLIT";
+	PGM_P splitstr = PSTR("SPLIT");
 		
 	//Write string to position
 	if(sp_status)
 	{
-	    lcd_putstring(calcx(xpos), calcy(ypos), splitstr, 1, WHITE, bcolor);
+	    lcd_putstring_P(calcx(xpos), calcy(ypos), splitstr, 1, WHITE, bcolor);
 	}    
 	else
 	{
-	    lcd_putstring(calcx(xpos), calcy(ypos), splitstr, 1, DARK_GRAY, bcolor);
+	    lcd_putstring_P(calcx(xpos), calcy(ypos), splitstr, 1, DARK_GRAY, bcolor);
 	}    
 }
 
@@ -1093,15 +1729,15 @@ void show_scan_status(int status, int bc)
 	
 	switch(status)
 	{
-		case 0: lcd_putstring(calcx(xpos), calcy(ypos), "SCAN", 1, WHITE, bcolor);
+		case 0: lcd_putstring_P(calcx(xpos), calcy(ypos), PSTR("SCAN"), 1, WHITE, bcolor);
 		        break;
-		case 1: lcd_putstring(calcx(xpos), calcy(ypos), "VFO ", 1, WHITE, bcolor);
+		case 1: lcd_putstring_P(calcx(xpos), calcy(ypos), PSTR("VFO "), 1, WHITE, bcolor);
 		        break;
-		case 2: lcd_putstring(calcx(xpos), calcy(ypos), "VFO*", 1, WHITE, bcolor);
+		case 2: lcd_putstring_P(calcx(xpos), calcy(ypos), PSTR("VFO*"), 1, WHITE, bcolor);
 		        break;        
-		case 3: lcd_putstring(calcx(xpos), calcy(ypos), "BND ", 1, WHITE, bcolor);
+		case 3: lcd_putstring_P(calcx(xpos), calcy(ypos), PSTR("BND "), 1, WHITE, bcolor);
 		        break;
-		case 4: lcd_putstring(calcx(xpos), calcy(ypos), "BND*", 1, WHITE, bcolor);
+		case 4: lcd_putstring_P(calcx(xpos), calcy(ypos), PSTR("BND*"), 1, WHITE, bcolor);
 		        break;                
 	}
 }	
@@ -1110,10 +1746,10 @@ void show_scan_status(int status, int bc)
 void show_sideband(int sb, int bc)
 {
 	int xpos = 21, ypos = 1;
-	char *sidebandstr[] = {"LSB", "USB"};
+	static const char sidebandstr[2][4] PROGMEM = {"LSB", "USB"};
 		
 	//Write string to position
-	lcd_putstring(calcx(xpos), calcy(ypos), sidebandstr[sb], 1, YELLOW, bc);
+	lcd_putstring_P(calcx(xpos), calcy(ypos), sidebandstr[sb], 1, YELLOW, bc);
 }
 
 
@@ -1121,69 +1757,50 @@ void show_sideband(int sb, int bc)
 void show_voltage(int bc)
 {
     char *buf;
-	int t1;
 	int xpos = 21, ypos = 3;	
 	int fc = LIGHT_BLUE;
 		
 	int adc_v;
-    double v1;		
     	 
 	//Measure current voltage	
-	v1 = (double) get_adc(3) * 5 / 1024 * 5 * 10;
-	adc_v = (int) v1;
+	adc_v = get_volts10();
    	
-   	if(v1 < 110)
+   	if(adc_v < 110)
    	{
 		fc = RED;
 	}
 	
-	if(v1 > 150)
+	if(adc_v > 150)
    	{
 		fc = ORANGE;
 	}
 	
-	buf = malloc(10);
-	
-	//Init buffer string
-	for(t1 = 0; t1 < 10; t1++)
-	{
-	    *(buf + t1) = 0;
-	}
+	buf = scratch_alloc(10);
     
     //Display value
-    lcd_putstring(calcx(xpos), calcy(ypos), "     ", 1, 0, bc);
+    lcd_putstring_P(calcx(xpos), calcy(ypos), PSTR("     "), 1, 0, bc);
     int2asc(adc_v, 1, buf, 6);
     lcd_putstring(calcx(xpos), calcy(ypos), buf, 1, fc, bc);
 	lcd_putchar(calcx(xpos + strlen(buf)), calcy(ypos), 'V', 1, fc, bc);
 	
 	//Free mem
-	free(buf);
+	scratch_release(buf);
 }
 
 //Temperature display
 void show_temp(int bc)
 {
     char *buf;
-	int t1, fc;
+	int fc;
 	int xpos = 21, ypos = 4;	
 		
 	int adc_t;
-    double r1, temp1;		
     	
-	//Measure current voltage	
-	r1 = 2000.0 / (1024.0 / get_adc(2) - 1);
-	temp1 = (double) (10.0 * (r1 - 1630) / 17.62); 
-	
-    adc_t = (int) temp1;
+	//Measure current temperature	
+    adc_t = get_temp10();
    	
-	lcd_putstring(calcx(xpos), calcy(ypos), "     ", 1, WHITE, bc);
-	buf = malloc(10);
-	
-	//Init buffer string
-	for(t1 = 0; t1 < 10; t1++)
-	{
-	    *(buf + t1) = 0;
-	}
+	lcd_putstring_P(calcx(xpos), calcy(ypos), PSTR("     "), 1, WHITE, bc);
+	buf = scratch_alloc(10);
     
     if(adc_t < 300)
     {
@@ -1206,34 +1823,34 @@ void show_temp(int bc)
 	lcd_putchar(calcx(xpos + strlen(buf)), calcy(ypos) - 1, 0x80, 1, fc, bc);
 	
 	//Free mem
-	free(buf);
+	scratch_release(buf);
 }
 
 //AGC speed
 void show_agc(int agc, int bc)
 {
 	int xpos = 6, ypos = 3;
-	lcd_putstring(calcx(xpos), calcy(ypos), "AGC  ", 1, GRAY, DARK_BLUE2);				
-	char *agcstr[] = {"FAST ", "NORM ", "SLOW ", "XSLOW"}; 
-	lcd_putstring(calcx(xpos), calcy(ypos + 1) - 1, agcstr[agc], 1, GREEN, DARK_BLUE2);			
+	lcd_putstring_P(calcx(xpos), calcy(ypos), PSTR("AGC  "), 1, GRAY, DARK_BLUE2);				
+	static const char agcstr[4][6] PROGMEM = {"FAST ", "NORM ", "SLOW ", "XSLOW"}; 
+	lcd_putstring_P(calcx(xpos), calcy(ypos + 1) - 1, agcstr[agc], 1, GREEN, DARK_BLUE2);			
 }
 
 //Tone pitch
 void show_tone(int tone, int bc)
 {
 	int xpos = 0, ypos = 3;
-	lcd_putstring(calcx(xpos), calcy(ypos), "TONE ", 1, GRAY, DARK_BLUE2);				
-	char *tstr[] = {"HIGH", "NORM", "LOW ", "XLOW"};
-	lcd_putstring(calcx(xpos), calcy(ypos + 1) - 1, tstr[tone], 1, RED, DARK_BLUE2);				
+	lcd_putstring_P(calcx(xpos), calcy(ypos), PSTR("TONE "), 1, GRAY, DARK_BLUE2);				
+	static const char tstr[4][5] PROGMEM = {"HIGH", "NORM", "LOW ", "XLOW"};
+	lcd_putstring_P(calcx(xpos), calcy(ypos + 1) - 1, tstr[tone], 1, RED, DARK_BLUE2);				
 }
 
 //Tone pitch
 void show_att(int att, int bc)
 {
 	int xpos = 12, ypos = 3;
-	lcd_putstring(calcx(xpos), calcy(ypos), "ATT ", 1, GRAY, DARK_BLUE2);				
-	char *attstr[] = {"OFF ", "ON  "}; 
-	lcd_putstring(calcx(xpos), calcy(ypos + 1) - 1, attstr[att], 1, GREEN, DARK_BLUE2);			
+	lcd_putstring_P(calcx(xpos), calcy(ypos), PSTR("ATT "), 1, GRAY, DARK_BLUE2);				
+	static const char attstr[2][5] PROGMEM = {"OFF ", "ON  "}; 
+	lcd_putstring_P(calcx(xpos), calcy(ypos + 1) - 1, attstr[att], 1, GREEN, DARK_BLUE2);			
 }
 
 
@@ -1243,13 +1860,13 @@ void show_txrx(int tx)
 	int x = 22, y = 12;
 	if(tx)
 	{
-		lcd_putstring(calcx(x), calcy(y - 1), " TX ", 1, LIGHT_RED, WHITE);
-		lcd_putstring(calcx(x), calcy(y), " RX ", 1, DARK_GRAY, BLACK0);
+		lcd_putstring_P(calcx(x), calcy(y - 1), PSTR(" TX "), 1, LIGHT_RED, WHITE);
+		lcd_putstring_P(calcx(x), calcy(y), PSTR(" RX "), 1, DARK_GRAY, BLACK0);
 	}
 	else
 	{
-		lcd_putstring(calcx(x), calcy(y - 1), " TX ", 1, DARK_GRAY, BLACK0);
-		lcd_putstring(calcx(x), calcy(y), " RX ", 1, LIGHT_GREEN, DARK_GRAY);
+		lcd_putstring_P(calcx(x), calcy(y - 1), PSTR(" TX "), 1, DARK_GRAY, BLACK0);
+		lcd_putstring_P(calcx(x), calcy(y), PSTR(" RX "), 1, LIGHT_GREEN, DARK_GRAY);
 	}
 		
 }
@@ -1261,11 +1878,11 @@ void draw_meter_scale(int scaletype, int bc)
 	
 	if(!scaletype)
 	{
-		lcd_putstring(calcx(x), calcy(y), "S1 3 5 7 9 +10 +20dB", 1, WHITE, bcolor);
+		lcd_putstring_P(calcx(x), calcy(y), PSTR("S1 3 5 7 9 +10 +20dB"), 1, WHITE, bcolor);
 	}
 	else
 	{
-		lcd_putstring(calcx(x), calcy(y), "P 1 2  4  6 8 10 20W", 1, WHITE, bcolor);
+		lcd_putstring_P(calcx(x), calcy(y), PSTR("P 1 2  4  6 8 10 20W"), 1, WHITE, bcolor);
 	}
 }		
 
@@ -1275,6 +1892,8 @@ void smeter(int value, int bc)
 	int v, t1, t2;
 	int x = 0, y = SMETERPOSITION; //Position on screen
 	int fc = WHITE;
+	
+	PROF_START(PROF_METER);
 	v = value;
 	
 	if(v > SMAX)
@@ -1323,6 +1942,7 @@ void smeter(int value, int bc)
 		smaxold = v;
 	}	
 	
+	PROF_STOP(PROF_METER);
 }
 
 void clear_smeter(int bc)
@@ -1383,6 +2003,19 @@ void show_msg(char *msg, int bc)
 	lcd_putstring(calcx(x), calcy(y), msg, 1, LIGHT_GRAY, bc);
 }	
 
+//Message from flash
+void show_msg_P(PGM_P msg, int bc)
+{
+	if(!pgm_read_byte(msg))
+	{
+		show_msg("", bc);
+	}
+	else
+	{
+		lcd_putstring_P(calcx(0), calcy(14), msg, 1, LIGHT_GRAY, bc);
+	}
+}	
+
 //Show memory place by number
 void show_mem_number(int mem_addr)
 {
@@ -1390,12 +2023,12 @@ void show_mem_number(int mem_addr)
     	
 	if(mem_addr == -1)
 	{
-		lcd_putstring(calcx(xpos + FONTWIDTH * 2), calcy(ypos), "--", 1, LIGHT_GRAY, bcolor);
+		lcd_putstring_P(calcx(xpos + FONTWIDTH * 2), calcy(ypos), PSTR("--"), 1, LIGHT_GRAY, bcolor);
 		return;
 	}	
 	
 	//Show number of mem place
-	lcd_putstring(calcx(xpos), calcy(ypos), "M", 1, WHITE, bcolor);
+	lcd_putstring_P(calcx(xpos), calcy(ypos), PSTR("M"), 1, WHITE, bcolor);
 		
 	if(mem_addr < 10)
 	{
@@ -1419,7 +2052,7 @@ void show_mem_freq(long f, int bc)
 	} 
 	else  
     {
-	    lcd_putstring(calcx(xpos), calcy(ypos), " ----- ", 1, fcolor, bc);			
+	    lcd_putstring_P(calcx(xpos), calcy(ypos), PSTR(" ----- "), 1, fcolor, bc);			
 	} 
 }	
 
@@ -1427,11 +2060,23 @@ void show_mem_freq(long f, int bc)
  // STRING FUNCTIONS //
 //////////////////////
 //INT 2 ASC
+//dec = number of digits after decimal point (0 or -1: none), buflen = size of buf incl. terminating 0
+//Each digit is found by subtracting its power of ten (max. 9 times), no 32 bit division needed
 int int2asc(long num, int dec, char *buf, int buflen)
 {
-    int i, c, xp = 0, neg = 0;
-    long n, dd = 1E09;
-
+	unsigned long n, p;
+	int t1, c = 0, lead = 1;
+	char d;
+	
+	if(buflen < 2)
+	{
+		if(buflen)
+		{
+			*buf = 0;
+		}	
+		return 0;
+	}	
+	
     if(!num)
 	{
 	    *buf++ = '0';
@@ -1441,111 +2086,97 @@ int int2asc(long num, int dec, char *buf, int buflen)
 		
     if(num < 0)
     {
-     	neg = 1;
-	    n = num * -1;
+		buf[c++] = '-';
+	    n = 0UL - (unsigned long) num;
     }
     else
     {
 	    n = num;
     }
-
-    //Fill buffer with \0
-    for(i = 0; i < 12; i++)
-    {
-	    *(buf + i) = 0;
-    }
-
-    c = 9; //Max. number of displayable digits
-    while(dd)
-    {
-	    i = n / dd;
-	    n = n - i * dd;
-	
-	    *(buf + 9 - c + xp) = i + 48;
-	    dd /= 10;
-	    if(c == dec && dec)
-	    {
-	        *(buf + 9 - c + ++xp) = '.';
-	    }
-	    c--;
-    }
-
-    //Search for 1st char different from '0'
-    i = 0;
-    while(*(buf + i) == 48)
-    {
-	    *(buf + i++) = 32;
-    }
-
-    //Add minus-sign if neccessary
-    if(neg)
-    {
-	    *(buf + --i) = '-';
-    }
-
-    //Eleminate leading spaces
-    c = 0;
-    while(*(buf + i))
-    {
-	    *(buf + c++) = *(buf + i++);
-    }
-    *(buf + c) = 0;
+    
+	for(t1 = 0; t1 < 10 && c < buflen - 1; t1++)
+	{
+		p = pgm_read_dword(&dec_pow10[t1]);
+		d = '0';
+		while(n >= p)
+		{
+			n -= p;
+			d++;
+		}
+		
+		//Leading zeros are suppressed up to the decimal point (0.5 is shown as ".5")
+		if(d != '0' || !lead)
+		{
+			buf[c++] = d;
+			lead = 0;
+		}
+		
+		if(dec > 0 && 9 - t1 == dec && c < buflen - 1)
+		{
+			buf[c++] = '.';
+			lead = 0;
+		}	
+	}
+    buf[c] = 0;
 	
 	return c;
 }
 
-//ASCII To LONG
-
-long asc2long(char *inputstr)
+//Same as int2asc(), but right aligned to width chars (buf must hold width + 1)
+//Each digit keeps its position, so a display can redraw only the digits that have changed
+int int2asc_fixed(long num, int dec, char *buf, int width)
 {
+	int t1, len;
 	
-    int t1, t2;
-    long pow_of_ten;
-    long n;
-    long x = 0;
-   
-    for(t1 = 0; t1 < strlen(inputstr); t1++)
-    {
-        n = inputstr[strlen(inputstr) - t1 - 1] - 48;
-        pow_of_ten = 1;
-        for(t2 = 0; t2 < t1; t2++)
-        {
-            pow_of_ten *= 10;
-        }    
-        x += n * pow_of_ten;
-    }
-    return x;
-    
-}   
+	len = int2asc(num, dec, buf, width + 1);
+	for(t1 = len; t1 >= 0; t1--)
+	{
+		buf[t1 + width - len] = buf[t1];
+	}
+	for(t1 = 0; t1 < width - len; t1++)
+	{
+		buf[t1] = ' ';
+	}
+	
+	return width;
+}	
 
-//Get data from Chr(32) separated string
-void get_info_from_string(char *istr, char *buf, int pos)
+//ASCII to LONG in one pass: Optional sign and decimal digits, ending at ' ' or end of string
+//Returns 0 and the number in *val, -1 if malformed (no digits, other characters, e. g. "14.2E6")
+//Numbers out of range are saturated to +-2147483647
+int parse_long(char *s, long *val)
 {
-    int pos2 = 0;
-    int t1;
-    
-    //Find position 
-    for(t1 = 0; t1 < strlen(istr) && pos2 < pos; t1++)
-    {
-        if(istr[t1] == ' ')
-        {
-            pos2++;
-        }
-    }
-        
-    //Copy string to buffer
-    for(t1 = t1; t1 < strlen(istr); t1++)
-    {
-        if(istr[t1] != 32)
-        {
-            *buf++ = istr[t1];
-        }  
-        else
-        {
-            return;
-        }    
-    }
-}
+	unsigned long n = 0;
+	int neg = 0, digits = 0;
+	char d;
+	
+	if(*s == '-' || *s == '+')
+	{
+		neg = (*s++ == '-');
+	}	
+	
+	while(*s >= '0' && *s <= '9')
+	{
+		d = *s++ - '0';
+		if(n > 214748364 || (n == 214748364 && d > 7))
+		{
+			n = 2147483647;
+		}
+		else
+		{
+			n = n * 10 + d;
+		}
+		digits++;
+	}
+	
+	if(!digits || (*s && *s != ' '))
+	{
+		return -1;
+	}
+	
+	*val = neg ? -(long) n : (long) n;
+	return 0;
+}	
 
 
   /////////////////
@@ -1640,69 +2271,68 @@ void twi_init(void)
 //Send comand to MCP4725
 void mcp4725_set_value(int value)
 {
-   twi_start();
-   twi_write(0xC0); //Device address
-   twi_write(64);       		    	
-   twi_write(value >> 4); //8 MSBs
-   twi_write((value & 0x0F) << 4); //4LSBs
+   //Give up on first timeout, switching TWI off releases the bus
+   if(twi_start() || twi_write(0xC0) || twi_write(64) || twi_write(value >> 4) || twi_write((value & 0x0F) << 4))
+   {
+	   TWCR = 0;
+	   twi_init();
+	   return;
+   }	   
    twi_stop();			
 		
 } 
 
 void tx_preset_adjust(void)
 {
-	int key = 0, t1;
+	int key = 0;
 	int v1 = tx_preset[cur_band];
 	char *tmpstr;
 	
-	tmpstr = malloc(12);
-	for(t1 = 0; t1 < 10; t1++)
-	{
-		tmpstr[t1] = 0;
-	}	
+	tmpstr = scratch_alloc(12);
 	
 	PORTA |= 8; //TX on
+	trace_put(TR_TX, TR_TX_LOCAL | 1);
   
-	show_msg("      TX Preset", bcolor);
+	show_msg_P(PSTR("      TX Preset"), bcolor);
 	int2asc(v1, -1, tmpstr, 8);
     show_msg(tmpstr, bcolor);
     
-	while(get_keys());
-	key = get_keys();
+	key = ui_get_key(UI_SRV_CAT);
 			
 	while(!key)
 	{
-		if(tuningknob >= 1)  //Turn CW
+		if(knob_get() >= 1)  //Turn CW
 		{
 		    if(v1 < 4090)
 		    {
 				v1 += 5;
 			}
 						
-		    tuningknob = 0;
+		    knob_ack(1);
 		    int2asc(v1, -1, tmpstr, 8);
-		    show_msg("    ", bcolor);
+		    show_msg_P(PSTR("    "), bcolor);
 		    show_msg(tmpstr, bcolor);
 		    mcp4725_set_value(v1);
 		} 
 
-		if(tuningknob <= -1) //Turn CCW
+		if(knob_get() <= -1) //Turn CCW
 		{    
 		    if(v1 > 5)
 		    {
 				v1 -= 5;
 			}
 			
-		    tuningknob = 0;
+		    knob_ack(-1);
 		    int2asc(v1, -1, tmpstr, 8);
-		    show_msg("    ", bcolor);
+		    show_msg_P(PSTR("    "), bcolor);
 		    show_msg(tmpstr, bcolor);
 			mcp4725_set_value(v1);
 		}	
-		key = get_keys();
+		key = ui_get_key(UI_SRV_CAT);
 	}	
 	
 	PORTA &= ~(8); 		//TX off
+	trace_put(TR_TX, TR_TX_LOCAL);
 	
 	if(key == 2)
 	{
@@ -1710,7 +2340,7 @@ void tx_preset_adjust(void)
 		store_tx_preset(v1, cur_band);
 	}	
 	
-	free(tmpstr);
+	scratch_release(tmpstr);
 }	
 
 void store_tx_preset(int value, int band)
@@ -1718,11 +2348,10 @@ void store_tx_preset(int value, int band)
 	//MSB first
     int adr = 484 + band * 2;
     
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)adr++, (value >> 8) & 0x0f);
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)adr, value & 0xff);
-    show_msg("TX preset stored.", bcolor);
+    eeprom_store(adr++, (value >> 8) & 0x0f);
+    eeprom_store(adr, value & 0xff);
+    TRACE_EEPROM(adr - 1, value);
+    show_msg_P(PSTR("TX preset stored."), bcolor);
 }	
 
 int load_tx_preset(int band)
@@ -1734,22 +2363,33 @@ int load_tx_preset(int band)
 	 int adr = 484 + band * 2;
     int v = 0;
     
-    while(!eeprom_is_ready());
+    eeprom_wait();
     v = eeprom_read_byte((uint8_t*)adr++) << 8;
-    while(!eeprom_is_ready());
+    eeprom_wait();
     v += eeprom_read_byte((uint8_t*)adr);
-    show_msg("TX preset loaded:", bcolor);
-    buffer = malloc(16);
+    show_msg_P(PSTR("TX preset loaded:"), bcolor);
+    buffer = scratch_alloc(16);
     int2asc(v, -1, buffer, 15);
     lcd_putstring(calcx(x), calcy(y), buffer, 1, YELLOW, bcolor);
-    free(buffer);
+    scratch_release(buffer);
     return v;
 }	
 
-void twi_start(void)
+//Returns -1 if the bus hangs
+int twi_start(void)
 {
+	unsigned int t = TWI_TIMEOUT;
+	
     TWCR = (1<<TWINT)|(1<<TWSTA)|(1<<TWEN);
-    while ((TWCR & (1<<TWINT)) == 0);
+    while ((TWCR & (1<<TWINT)) == 0)
+    {
+		if(!--t)
+		{
+			twi_errors++;
+			return -1;
+		}
+	}
+	return 0;
 }
 
 //send stop signal
@@ -1758,49 +2398,106 @@ void twi_stop(void)
     TWCR = (1<<TWINT)|(1<<TWSTO)|(1<<TWEN);
 }
 
-void twi_write(uint8_t u8data)
+int twi_write(uint8_t u8data)
 {
+	unsigned int t = TWI_TIMEOUT;
+	
     TWDR = u8data;
     TWCR = (1<<TWINT)|(1<<TWEN);
-    while ((TWCR & (1<<TWINT)) == 0);
+    while ((TWCR & (1<<TWINT)) == 0)
+    {
+		if(!--t)
+		{
+			twi_errors++;
+			return -1;
+		}
+	}
+	return 0;
 }
 
   ///////////////////
  //   A   D   C   //
 ///////////////////
-//Read ADC value
+//Read latest ADC value from scanner table
 int get_adc(int adc_channel)
 {
+	int adc_v;
 	
-	int adc_val = 0;
-	
-	ADMUX = (1<<REFS0) + adc_channel;     // Kanal adcmode aktivieren
-    _delay_ms(3);
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		adc_v = adc_val[adc_channel];
+	}
 	
-    ADCSRA |= (1<<ADSC);
-    //while(ADCSRA & (1<<ADSC));
-	_delay_ms(3);
+	return adc_v;
+}	
+
+//Init ADC and fill the scanner table with one blocking conversion per channel
+void adc_init(void)
+{
+	int t1, t2;
+	unsigned int raw = 0;
 	
-	adc_val = ADCL;
-    adc_val += ADCH * 256;   
+	ADCSRA = (1<<ADPS1) | (1<<ADPS2) | (1<<ADEN); //Prescaler 64 and ADC on
 	
-	return adc_val;
+	for(t1 = 0; t1 < ADC_CHANNELS; t1++)
+	{
+		ADMUX = (1<<REFS0) + t1;
+		for(t2 = 0; t2 < 2; t2++) //1st conversion after mux switch is discarded
+		{
+			ADCSRA |= (1<<ADSC);
+			while(ADCSRA & (1<<ADSC));
+			raw = ADCW;
+		}
+		adc_val[t1] = raw;
+		adc_acc[t1] = raw << 4;
+		if(t1 == SMETER_CH)
+		{
+			sm_acc = raw << 5;
+		}	
+		adc_due[t1] = t1; //Spread channels over the first ticks
+	}
 	
+	ADCSRA |= (1<<ADIF) | (1<<ADIE); //Clear pending flag, conversion complete interrupt on
 }	
 
-//Read keys via ADC0
+//Start conversion of next due channel (round robin), called from ISRs only
+void adc_start_next(void)
+{
+	unsigned char t1, ch;
+	
+	for(t1 = 1; t1 <= ADC_CHANNELS; t1++)
+	{
+		ch = adc_ch + t1;
+		if(ch >= ADC_CHANNELS)
+		{
+			ch -= ADC_CHANNELS;
+		}
+			
+		if(!adc_due[ch])
+		{
+			adc_due[ch] = pgm_read_byte(&adc_period[ch]);
+			adc_ch = ch;
+			ADMUX = (1<<REFS0) + ch;
+			adc_discard = 1;
+			adc_busy = 1;
+			ADCSRA |= (1<<ADSC);
+			return;
+		}
+	}
+}		
+
+//Read current key level via ADC0
 int get_keys(void)
 {
+	return key_decode(get_adc(0));
+}
 
+//Convert ADC0 value to key number
+int key_decode(int adcval)
+{
     int key_value[] = {39, 143, 280};
-        	
     int t1;
-    int adcval = get_adc(0);
         
-    //TEST display of ADC value 
-    //lcd_putstring(0, 5, "....", 1, DARK_BLUE2, WHITE);    
-    //lcd_putnumber(0, 5, adcval, -1, 1, DARK_BLUE2, WHITE);    
-    	
     for(t1 = 0; t1 < 3; t1++)
     {
         if(adcval > key_value[t1] - 5 && adcval < key_value[t1] + 5)
@@ -1811,63 +2508,284 @@ int get_keys(void)
     return 0;
 }
 
-//Check PTT Pin PG2
-int get_ptt(void)
+//Key engine: Debounce ADC0 samples and generate events, called from ADC ISR
+void key_sample(int adcval)
 {
-	if(!(PING & (1 << PG2)))
-	{ 
-		return 1;
+	static unsigned char last = 0, cnt = 0, state = 0;
+	static unsigned char hold = 0;
+	unsigned char k = key_decode(adcval);
+	
+	if(k != last)
+	{
+		last = k;
+		cnt = 1;
+	}
+	else if(cnt < KEY_T_DEBOUNCE)
+	{
+		cnt++;
 	}	
-	else
+	
+	if(cnt < KEY_T_DEBOUNCE) //Level not stable yet
 	{
-		return 0;
+		return;
 	}	
 	
-}		
+	if(k != state) //Stable level has changed
+	{
+		if(state)
+		{
+			key_put(KEY_EV_RELEASE | state);
+		}
+		if(k)
+		{
+			key_put(KEY_EV_PRESS | k);
+		}
+		state = k;
+		hold = 0;
+	}
+	else if(state) //Key held
+	{
+		hold++;
+		if(hold == KEY_T_LONG)
+		{
+			key_put(KEY_EV_LONG | state);
+		}
+		if(hold >= KEY_T_LONG + KEY_T_REPEAT)
+		{
+			key_put(KEY_EV_REPEAT | state);
+			hold = KEY_T_LONG;
+		}	
+	}
+}	
 
-//Determine s-value
-//No sig=3V, Full sig=0V
-int get_s_value(void)
+//Put event into key queue, event is dropped if queue is full
+void key_put(unsigned char ev)
 {
-	int s = 620 - get_adc(4);
+	unsigned char h = (key_q_head + 1) & (KEY_QUEUE_LEN - 1);
 	
-	return ((s >> 2) + (s >> 3));  
-}	
-  ////////////////////////
- //  HARDWARE SETTINGS //
-////////////////////////
-void set_tone(int tone_value)
+	if(h != key_q_tail)
+	{
+		key_queue[key_q_head] = ev;
+		key_q_head = h;
+	}
+}		
+
+//Get next key event, 0 if queue is empty
+int key_get_event(void)
 {
-	int t1;
-	char *buf;
+	int ev;
 	
-	//Reset PG3 and PG4
-	PORTG &= ~(8);   //PG3 Lo
-	PORTG &= ~(16);  //PG4 Lo
+	if(key_q_tail == key_q_head)
+	{
+		return 0;
+	}
 	
-	PORTG |= tone_value << 3; // !!!
+	ev = key_queue[key_q_tail];
+	key_q_tail = (key_q_tail + 1) & (KEY_QUEUE_LEN - 1);
 	
-	cli();
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)480, tone_value);
-    sei();
-    
-    buf = malloc(32);
-	for(t1 = 0; t1 < MAXRXBUFLEN; t1++) //Init buffer
+	return ev;
+}		
+
+//Get number of next pressed key, other events are dropped, 0 if none
+int key_get_press(void)
+{
+	int ev = key_get_event();
+	
+	while(ev)
 	{
-	    buf[t1] = 0;
-	}    
-	strcpy(buf, "TONE  ");
-	buf[5] = tone_value + 48;
-	buf[6] = 0;
-	usart_sendstring(buf);
-	usart_send_crlf();
-	free(buf);
+		if(KEY_EVENT(ev) == KEY_EV_PRESS)
+		{
+			return KEY_NUM(ev);
+		}
+		ev = key_get_event();
+	}
+	
+	return 0;
+}		
+
+//Input wait of modal screens (menus, settings, scan...)
+//Keeps CAT and PTT alive in the meantime, their display output would
+//overwrite the screen so it is muted. Main screen is redrawn on exit.
+int ui_get_key(int srv)
+{
+	wdt_reset();
+	lcd_mute++;
+	if(srv & UI_SRV_PTT)
+	{
+		ptt_task();
+	}
+	if(srv & UI_SRV_CAT)
+	{
+		if(!(srv & UI_SRV_CAT_SET)) //Screen would show or store stale values
+		{
+			cat_locked = (srv & UI_SRV_PTT) ? CAT_LOCK_SET : CAT_LOCK_ALL;
+		}
+		cat_task();
+		cat_locked = 0;
+	}
+	lcd_mute--;
+	
+	return key_get_press();
+}		
+
+//Modal screen closed: DDS and main screen as they are now, PTT and CAT may have
+//changed them while the screen was open and its display output was muted
+void ui_restore(void)
+{
+	set_frequency1(f_vfo[split_vfo(txrx)]);
+	set_frequency2(f_lo[sideband]);
+	lcd_cls(bcolor);
+	show_all_data(f_vfo[split_vfo(txrx)], f_vfo[alt_vfo], 1, sideband, 0, cur_vfo, split, 0, 0, txrx, last_memplace, txrx);
+	show_mem_freq(freq_temp1, bcolor);
+}
+
+//Check PTT Pin PG2
+int get_ptt(void)
+{
+	if(!(PING & (1 << PG2)))
+	{ 
+		return 1;
+	}	
+	else
+	{
+		return 0;
+	}	
+	
+}		
+
+//Determine s-value in bar units (0..SMAX), same scale as s_threshold
+int get_s_value(void)
+{
+	int dbm = get_s_dbm();
+	int x;
+	
+	if(dbm <= SMETER_S9_DBM)
+	{
+		x = (dbm - SMETER_S9_DBM) * 2 + SMETER_S9_X; //S1..S9: 24 px per 2 S-units
+	}
+	else
+	{
+		x = (dbm - SMETER_S9_DBM) * 4 + SMETER_S9_X; //Over S9: 40 px per 10dB
+	}		
+	
+	if(x < 0)
+	{
+		x = 0;
+	}
+	
+	if(x > SMAX)
+	{
+		x = SMAX;
+	}	
+	
+	return x;  
+}	
+
+//Calibrated signal level in dBm
+//No sig=3V, Full sig=0V
+int get_s_dbm(void)
+{
+	unsigned int code;
+	int i, d0, d1;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		code = sm_acc >> 3; //12 bit
+	}
+	
+	i = code >> 8;
+	d0 = (signed char) pgm_read_byte(&smeter_dbm_tab[i]);
+	d1 = (signed char) pgm_read_byte(&smeter_dbm_tab[i + 1]);
+	
+	return d0 + (((d1 - d0) * (int) (code & 0xFF)) >> 8) + smeter_cal[cur_band];
+}	
+
+//Load S-Meter calibration for all bands
+void smeter_load_cal(void)
+{
+	int t1, v;
+	
+	for(t1 = 0; t1 < 6; t1++)
+	{
+		v = eeprom_read_byte((uint8_t*)SMETER_CAL_ADR + t1) - 64;
+		if(v < -40 || v > 40)
+		{
+			v = 0;
+		}	
+		smeter_cal[t1] = v;
+	}
+}	
+
+//Store S-Meter calibration offset (dB) for one band
+void smeter_store_cal(int band, int offset)
+{
+	smeter_cal[band] = offset;
+	
+	eeprom_store(SMETER_CAL_ADR + band, offset + 64);
+	TRACE_EEPROM(SMETER_CAL_ADR + band, offset + 64);
+}	
+
+//PA temperature in 1/10 deg. C, clamped to TEMP_MIN..TEMP_MAX
+int get_temp10(void)
+{
+	int a = get_adc(2);
+	int i = a >> TEMP_LUT_SHIFT;
+	int t0, t1;
+	long t;
+	
+	t0 = pgm_read_word(&temp_lut[i]);
+	t1 = pgm_read_word(&temp_lut[i + 1]);
+	t = t0 + (((long) (t1 - t0) * (a & ((1 << TEMP_LUT_SHIFT) - 1))) >> TEMP_LUT_SHIFT);
+	t /= 10;
+	
+	if(t < TEMP_MIN)
+	{
+		t = TEMP_MIN;
+	}
+	
+	if(t > TEMP_MAX)
+	{
+		t = TEMP_MAX;
+	}	
+	
+	return (int) t;
+}	
+
+//Supply voltage in 1/10 V
+int get_volts10(void)
+{
+	return (int) (((long) get_adc(3) * VDD_SCALE) >> 10);
+}	
+  ////////////////////////
+ //  HARDWARE SETTINGS //
+////////////////////////
+void set_tone(int tone_value)
+{
+	char *buf;
+	
+	//Reset PG3 and PG4
+	PORTG &= ~(8);   //PG3 Lo
+	PORTG &= ~(16);  //PG4 Lo
+	
+	PORTG |= tone_value << 3; // !!!
+	
+    eeprom_store(480, tone_value);
+    TRACE_EEPROM(480, tone_value);
+    
+    if(cat_mode == CAT_NATIVE && !cat_quiet) //Kenwood host would take it for a reply
+    {
+        buf = scratch_alloc(8);
+	    strcpy_P(buf, PSTR("TONE  "));
+	    buf[5] = tone_value + 48;
+	    buf[6] = 0;
+	    usart_sendstring(buf);
+	    usart_send_crlf();
+	    scratch_release(buf);
+	}
 }
 
 void set_agc(int agc_value)
 {
-	int t1;
 	char *buf;
 	
 	//Reset PG0 and PG1
@@ -1876,28 +2794,24 @@ void set_agc(int agc_value)
 	
 	PORTG |= agc_value;
 	
-	cli();
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)481, agc_value);
-    sei();
+    eeprom_store(481, agc_value);
+    TRACE_EEPROM(481, agc_value);
     
-    buf = malloc(32);
-	for(t1 = 0; t1 < MAXRXBUFLEN; t1++) //Init buffer
-	{
-	    buf[t1] = 0;
-	}    
-	strcpy(buf, "AGC  ");
-	buf[4] = agc_value + 48;
-	buf[5] = 0;
-	usart_sendstring(buf);
-	usart_send_crlf();
-	free(buf);
+    if(cat_mode == CAT_NATIVE && !cat_quiet)
+    {
+        buf = scratch_alloc(8);
+	    strcpy_P(buf, PSTR("AGC  "));
+	    buf[4] = agc_value + 48;
+	    buf[5] = 0;
+	    usart_sendstring(buf);
+	    usart_send_crlf();
+	    scratch_release(buf);
+	}
 }	
 
 void set_att(int att_value)
 {
 	char *buf;
-	int t1;
 	
 	if(att_value)
 	{
@@ -1908,28 +2822,25 @@ void set_att(int att_value)
 	    PORTB &= ~(1 << PB3);
 	}
 	    
-	cli();
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)483, att_value);
-    sei();
+    eeprom_store(483, att_value);
+    TRACE_EEPROM(483, att_value);
     
     //Send new ATT set to UART
-	buf = malloc(32);
-	for(t1 = 0; t1 < MAXRXBUFLEN; t1++) //Init buffer
-	{
-	    buf[t1] = 0;
-	}    
-	if(!att_value)
-	{
-	    strcpy(buf, "ATT 0");
-	}
-	else    
-	{
-	    strcpy(buf, "ATT 1");
+    if(cat_mode == CAT_NATIVE && !cat_quiet)
+    {
+	    buf = scratch_alloc(8);
+	    if(!att_value)
+	    {
+	        strcpy_P(buf, PSTR("ATT 0"));
+	    }
+	    else    
+	    {
+	        strcpy_P(buf, PSTR("ATT 1"));
+	    }
+	    usart_sendstring(buf);
+	    usart_send_crlf();
+	    scratch_release(buf);
 	}
-	usart_sendstring(buf);
-	usart_send_crlf();
-	free(buf);
 }
 
 
@@ -1957,8 +2868,10 @@ void set_band(int band, int vfo)
 		 }    
 	}    
         			            
+	trace_put(TR_BAND, band | (txrx << 8));
 	set_frequency1(f_vfo[vfo]);
 	sideband = std_sideband[band];
+	trace_put(TR_SIDEBAND, sideband);
     set_frequency2(f_lo[sideband]);
     show_frequency1(f_vfo[vfo], 1, bcolor);
     show_sideband(sideband, 0);
@@ -1977,56 +2890,52 @@ void set_band(int band, int vfo)
 	PORTA |= band + 1;
 	
 	//Send info to USART
-	buf0 = malloc(10);
-	buf1 = malloc(10);
-	for(t1 = 0; t1 < 8; t1++) //Init buffer
+	if(cat_mode == CAT_NATIVE && !cat_quiet)
 	{
-	    buf0[t1] = 0;
-	    buf1[t1] = 0;
-	}    
-	strcpy(buf0, "BAND ");
-	int2asc(band, -1, buf1, 8);
-	strcat(buf0, buf1);
-	usart_sendstring(buf0);
-	usart_send_crlf();
-	free(buf0);
-	free(buf1);
+	    buf0 = scratch_alloc(10);
+	    buf1 = scratch_alloc(10);
+	    strcpy_P(buf0, PSTR("BAND "));
+	    int2asc(band, -1, buf1, 8);
+	    strcat(buf0, buf1);
+	    usart_sendstring(buf0);
+	    usart_send_crlf();
+	    scratch_release(buf0); //and buf1
+	}
 	
 }
 
 //Set new VFO
 int set_vfo(int vfo)
 {
-	int t1;
 	char *buf;
 	
 	if(!is_mem_freq_ok(f_vfo[vfo], cur_band)) //Invalid data
 	{
-		 show_msg("Invalid data!", bcolor);
+		 show_msg_P(PSTR("Invalid data!"), bcolor);
 	     return 0;
 	}	     
+	trace_put(TR_VFO, vfo | (txrx << 8));
 	set_frequency1(f_vfo[vfo]);
 	set_frequency2(f_lo[sideband]);
 	show_frequency1(f_vfo[vfo], 1, bcolor);
 	show_vfo(vfo, bcolor);
 	//Send new VFO to UART
-	buf = malloc(32);
-	for(t1 = 0; t1 < MAXRXBUFLEN; t1++) //Init buffer
+	if(cat_mode == CAT_NATIVE && !cat_quiet)
 	{
-	    buf[t1] = 0;
-	}    
+	    buf = scratch_alloc(8);
 	
-	if(!vfo)
-	{
-	    strcpy(buf, "VFO A");
-	}
-	else    
-	{
-	    strcpy(buf, "VFO B");
+	    if(!vfo)
+	    {
+	        strcpy_P(buf, PSTR("VFO A"));
+	    }
+	    else    
+	    {
+	        strcpy_P(buf, PSTR("VFO B"));
+	    }
+	    usart_sendstring(buf);
+	    usart_send_crlf();
+	    scratch_release(buf);
 	}
-	usart_sendstring(buf);
-	usart_send_crlf();
-	free(buf);
 	return 1;
 }
 
@@ -2098,6 +3007,9 @@ void set_frequency1(long frequency)
     int t1, t2, shiftbyte = 24, resultbyte, x;
     long comparebyte = 0xFF000000;
 	
+	PROF_START(PROF_DDS1);
+	trace_put(TR_DDS1, frequency);
+	
 	f = frequency + 3000; //Offset because of inaccuracy of crystal oscillator
 		 
 	if(!sideband)//Calculate correct offset from center frequency in display for each sideband
@@ -2137,6 +3049,8 @@ void set_frequency1(long frequency)
 	
 	//End transfer sequence
     DDS1_PORT|= (DDS1_IO_UD); //DDS1_IO_UD hi 
+    
+    PROF_STOP(PROF_DDS1);
 }
 
   ////////////////////////
@@ -2179,6 +3093,9 @@ void set_frequency2(long f)
     int fclk = 100;
     double fact;
     
+    PROF_START(PROF_DDS2);
+    trace_put(TR_DDS2, f);
+    
     //fact = 268435456 / fClk
     switch(fclk)
     {
@@ -2245,6 +3162,8 @@ void set_frequency2(long f)
        dds2_send_bit(m[t1]);
     }
     dds2_stop();
+    
+    PROF_STOP(PROF_DDS2);
 }
 
 
@@ -2256,46 +3175,46 @@ void set_lo_freq(int sb)
 	
 	lcd_cls(bcolor);
 		
-	lcd_putstring(calcx(2), calcy(1), "Set LO FREQ ", 1, fcolor, bcolor);
+	lcd_putstring_P(calcx(2), calcy(1), PSTR("Set LO FREQ "), 1, fcolor, bcolor);
 	if(!sb)
 	{
-		lcd_putstring(calcx(2), calcy(3), "LSB", 1, fcolor, bcolor);
+		lcd_putstring_P(calcx(2), calcy(3), PSTR("LSB"), 1, fcolor, bcolor);
 	}
 	else	
 	{
-		lcd_putstring(calcx(2), calcy(3), "USB", 1, fcolor, bcolor);
+		lcd_putstring_P(calcx(2), calcy(3), PSTR("USB"), 1, fcolor, bcolor);
 	}
 	
 	print_menu_help(2, 8, LIGHT_BLUE, bcolor);
 		
-	key = get_keys();
+	key = ui_get_key(UI_SRV_ALL);
 	show_frequency2(8, 3, f, bcolor, 1, 3);
 	
 	while(key == 0)
 	{
-		if(tuningknob >= 1) //Turn CW
+		if(knob_get() >= 1) //Turn CW
 		{
 			f += 10;
-		    tuningknob = 0;
+		    knob_ack(1);
 	        show_frequency2(8, 3, f, bcolor, 1, 3);
 	        set_frequency2(f);
 		}
 
-		if(tuningknob <= -1)  //Turn CCW
+		if(knob_get() <= -1)  //Turn CCW
 		{    
 		    f -= 10;
-		    tuningknob = 0;
+		    knob_ack(-1);
 		    show_frequency2(8, 3, f, bcolor, 1, 3);
 		    set_frequency2(f);
 		}		
-		key = get_keys();
+		key = ui_get_key(UI_SRV_ALL);
 	}
 	
 	if(key == 2)
 	{
 		f_lo[sb] = f; //Confirm
 		store_frequency1(f, 512 + sb * 4); //Save frequency to memplace 512 (LSB) or 516 (USB)
-		show_msg("New LO freq stored.", bcolor);
+		show_msg_P(PSTR("New LO freq stored."), bcolor);
 	}	
 	else
 	{
@@ -2307,6 +3226,33 @@ void set_lo_freq(int sb)
   /////////////////////////
  //   E  E  P  R  O  M  //
 /////////////////////////
+//Wait for end of previous write, give up after EEPROM_TIMEOUT
+//Busy loop, so it also works with interrupts disabled
+int eeprom_wait(void)
+{
+	unsigned int t = EEPROM_TIMEOUT;
+	
+	while(!eeprom_is_ready())
+	{
+		if(!t--)
+		{
+			eeprom_timeouts++;
+			return -1;
+		}
+		_delay_us(10);
+	}
+	return 0;
+}	
+
+//Write one byte, all EEPROM writes go through here (profiled as PROF_EEPROM)
+void eeprom_store(unsigned int adr, unsigned char v)
+{
+	PROF_START(PROF_EEPROM);
+	eeprom_wait();
+	eeprom_write_byte((uint8_t*)adr, v);
+	PROF_STOP(PROF_EEPROM);
+}	
+
 //Store MEM Frequency
 void store_frequency0(long f, int mem)
 {
@@ -2322,7 +3268,6 @@ void store_frequency1(long f, int start_adr)
     long hiword, loword;
     unsigned char hmsb, lmsb, hlsb, llsb;
 	
-	cli();
     hiword = f >> 16;
     loword = f - (hiword << 16);
     hmsb = hiword >> 8;
@@ -2330,20 +3275,15 @@ void store_frequency1(long f, int start_adr)
     lmsb = loword >> 8;
     llsb = loword - (lmsb << 8);
 
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)start_adr, hmsb);
+    eeprom_store(start_adr, hmsb);
 
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)start_adr + 1, hlsb);
+    eeprom_store(start_adr + 1, hlsb);
 
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)start_adr + 2, lmsb);
+    eeprom_store(start_adr + 2, lmsb);
 
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)start_adr + 3, llsb);
+    eeprom_store(start_adr + 3, llsb);
     
-    sei();	
-	
+    trace_put(TR_EEPROM_FREQ, f);
 }
 
 //Load a frequency from memory by memplace
@@ -2360,12 +3300,10 @@ long load_frequency1(int start_adr)
 {
     unsigned char hmsb, lmsb, hlsb, llsb;
     		
-    cli();
     hmsb = eeprom_read_byte((uint8_t*)start_adr);
     hlsb = eeprom_read_byte((uint8_t*)start_adr + 1);
     lmsb = eeprom_read_byte((uint8_t*)start_adr + 2);
     llsb = eeprom_read_byte((uint8_t*)start_adr + 3);
-	sei();
 	
     return (long) 16777216 * hmsb + (long) 65536 * hlsb + (unsigned int) 256 * lmsb + llsb;
     //rf = (long) (hmsb << 24) + (long) (hlsb << 16) + (long) (lmsb << 8) + llsb;
@@ -2391,73 +3329,28 @@ int is_mem_freq_ok(long f, int cband)
 	}		
 }	
 
-//Send 6 by 16 mem frequencies to uasrt0
-void txm_mem_frequencies(void)
-{
-	int c = 0;
-	int key;
-	char *sbuf;
-	
-	sbuf = malloc(32);
-		
-	while(get_keys());
-	
-	for(c = 0; c < 384 && !key; c++)
- 	{
-		key = get_keys();
-		usart_transmit(eeprom_read_byte((uint8_t*)c));
-	}	
-		
-	int2asc(c, -1, sbuf, 8);
-	strcat(sbuf, " Bytes transmitted.");
-	show_msg(sbuf, bcolor);
-	free(sbuf);
-	_delay_ms(1000);
-
-}	
-//Load 6 by 16 mem frequencies via uasrt0
-void rcv_mem_frequencies(void)
+//Memories are transferred as EEPROM chunks by binary CAT frames (catb_eeprom()) from the main screen
+//or from this one (other modal screens refuse them),
+//this screen serves CAT and shows the progress until a key is pressed
+void mem_transfer(void)
 {
-	int c = 0, r, t1;
-	int key;
+	unsigned int shown = 0xFFFF;
 	char *sbuf;
-	char dbuf[384];
-	int maxbytes = 384;
 	
-	sbuf = malloc(32);
+	sbuf = scratch_alloc(16);
+	show_msg_P(PSTR("CAT transfer..."), bcolor);
 	
-	while(get_keys());
-	
-	//Empty RX buffer
-	r = usart_receive();
-	while(r > -1)
-	{
-		r = usart_receive();
-	}
-	show_msg("Ready.", bcolor);
-		
-	while(c < maxbytes && !key)
+	while(!ui_get_key(UI_SRV_CAT | UI_SRV_CAT_SET))
 	{
-		r = usart_receive();
-		if(r > -1)
+		if(shown != catb_ee_chunks)
 		{
-			dbuf[c++] = r;
+			shown = catb_ee_chunks;
+			int2asc(shown, -1, sbuf, 8);
+			strcat_P(sbuf, PSTR(" chunks."));
+			show_msg(sbuf, bcolor);
 		}
-		//key = get_keys();
 	}
-	
-	int2asc(c, -1, sbuf, 8);
-	strcat(sbuf, " Bytes received.");
-	show_msg(sbuf, bcolor);
-	free(sbuf);
-	_delay_ms(1000);
-		
-	//Store data in EEPROM	
-	for(t1 = 0; t1 < maxbytes; t1++)
-	{
-	    eeprom_write_byte((uint8_t*)t1, dbuf[t1]);
-	}    
-	show_msg("Data stored.", bcolor);
+	scratch_release(sbuf);
 }			
 	
 
@@ -2465,20 +3358,16 @@ void rcv_mem_frequencies(void)
 void store_last_band(int bandnum)
 {
     
-	cli();
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)440, bandnum);
-    sei();	
+    eeprom_store(440, bandnum);
+    TRACE_EEPROM(440, bandnum);
 }
 
 //Store last VFO used
 void store_last_vfo(int vfonum)
 {
     
-	cli();
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)441, vfonum);
-    sei();	
+    eeprom_store(441, vfonum);
+    TRACE_EEPROM(441, vfonum);
 }
 
 //Load last VFO stored
@@ -2486,9 +3375,7 @@ int load_last_band(void)
 {
     int bandnum;
     
-    cli();
     bandnum = eeprom_read_byte((uint8_t*)440);
-    sei();
 	
 	if(bandnum >= 0 && bandnum <= 7)
 	{
@@ -2505,9 +3392,7 @@ int load_last_vfo(void)
 {
     int vfonum;
     
-    cli();
     vfonum = eeprom_read_byte((uint8_t*)441);
-    sei();
 	
 	if(vfonum >= 0 && vfonum <= 15)
 	{
@@ -2522,8 +3407,8 @@ int load_last_vfo(void)
 //Store last used memplace
 void store_last_mem(int mem)
 {
-	while(!eeprom_is_ready());
-	eeprom_write_byte((uint8_t*)127, mem);
+	eeprom_store(127, mem);
+	TRACE_EEPROM(127, mem);
 }
 
 //Recall AND display a frequency from memory
@@ -2535,7 +3420,7 @@ long recall_mem_freq(int mem_addr)
 	int fcolor = WHITE;
 	
 	lcd_cls(bcolor);
-	lcd_putstring(calcx(0), calcy(3), "RECALL",  1, fcolor, bcolor);
+	lcd_putstring_P(calcx(0), calcy(3), PSTR("RECALL"),  1, fcolor, bcolor);
 	
 	//Load initial freq
 	if(is_mem_freq_ok(load_frequency0(mem_addr), cur_band))
@@ -2553,7 +3438,7 @@ long recall_mem_freq(int mem_addr)
 	key = 0;
 	while(!key)
 	{
-		if(tuningknob <= -1)  
+		if(knob_get() <= -1)  
 		{    
 		    if(mem_addr > 0)
 		    {
@@ -2564,7 +3449,7 @@ long recall_mem_freq(int mem_addr)
 			    mem_addr = MAXMEM;
 			}	 
 			
-			tuningknob = 0;
+			knob_ack(-1);
 			
 			show_mem_number(mem_addr);
 			if(is_mem_freq_ok(load_frequency0(mem_addr), cur_band))
@@ -2578,7 +3463,7 @@ long recall_mem_freq(int mem_addr)
 			}	
 	    }
 		
-		if(tuningknob >= 1)
+		if(knob_get() >= 1)
 		{    
 		    if(mem_addr < MAXMEM)
 		    {
@@ -2589,7 +3474,7 @@ long recall_mem_freq(int mem_addr)
 			    mem_addr = 0;
 			}	 
 			
-			tuningknob = 0;
+			knob_ack(1);
 			
 			show_mem_number(mem_addr);
 			if(is_mem_freq_ok(load_frequency0(mem_addr), cur_band))
@@ -2603,7 +3488,7 @@ long recall_mem_freq(int mem_addr)
 			}	
 	    }
 	    
-	    key = get_keys();
+	    key = ui_get_key(UI_SRV_ALL);
 	}	
 	            
 	switch(key)
@@ -2616,7 +3501,6 @@ long recall_mem_freq(int mem_addr)
 				break;
 	}	
 								
-    while(get_keys());
     
     return 0;
 }	
@@ -2630,7 +3514,7 @@ int save_mem_freq(long f, int mem)
 	int fcolor = WHITE;
 	
 	lcd_cls(bcolor);
-	lcd_putstring(0, 0, "STORE", 1, fcolor, bcolor);
+	lcd_putstring_P(0, 0, PSTR("STORE"), 1, fcolor, bcolor);
 	
 	//Load initial mem
 	show_mem_number(mem_addr);
@@ -2643,7 +3527,7 @@ int save_mem_freq(long f, int mem)
 	key = 0;
 	while(!key)
 	{
-		if(tuningknob <= -1)
+		if(knob_get() <= -1)
 		{    
 		    if(mem_addr > 0)
 		    {
@@ -2654,7 +3538,7 @@ int save_mem_freq(long f, int mem)
 			    mem_addr = MAXMEM;
 			}	 
 			
-			tuningknob = 0;
+			knob_ack(-1);
 			
 			show_mem_number(mem_addr);
 			mem_freq = load_frequency0(mem_addr);
@@ -2670,7 +3554,7 @@ int save_mem_freq(long f, int mem)
 			}	
 	    }
 		
-		if(tuningknob >= 1)  
+		if(knob_get() >= 1)  
 		{    
 		    if(mem_addr < MAXMEM)
 		    {
@@ -2681,7 +3565,7 @@ int save_mem_freq(long f, int mem)
 			    mem_addr = 0;
 			}	 
 			
-			tuningknob = 0;
+			knob_ack(1);
 			
 			show_mem_number(mem_addr);
 			mem_freq = load_frequency0(mem_addr);
@@ -2697,7 +3581,7 @@ int save_mem_freq(long f, int mem)
 			}
 	    }
 	    
-	    key = get_keys();
+	    key = ui_get_key(UI_SRV_ALL);
 	}	
 	            
 	switch(key)
@@ -2708,7 +3592,6 @@ int save_mem_freq(long f, int mem)
 	            	break;
 	}	
 								
-    while(get_keys());
     
     return -1;
 }	
@@ -2716,7 +3599,7 @@ int save_mem_freq(long f, int mem)
   //////////
  // MENU //
 //////////
-void print_menu_head(char *head_str0, int m_items)
+void print_menu_head(PGM_P head_str0, int m_items)
 {	
     int xpos0 = 1;
 	int ypos0 = 1;
@@ -2726,7 +3609,7 @@ void print_menu_head(char *head_str0, int m_items)
 	
 	drawbox(132, 24, 238, FONTHEIGHT * m_items + 56, WHITE);
 	
-	lcd_putstring(calcx(xpos0), calcy(ypos0 + 1), head_str0,  1, fcolor, bcolor);
+	lcd_putstring_P(calcx(xpos0), calcy(ypos0 + 1), head_str0,  1, fcolor, bcolor);
 		
 	fcolor = LIGHT_GRAY;
 	print_menu_help(xpos0, ypos0 + 8, fcolor, bcolor);
@@ -2735,14 +3618,14 @@ void print_menu_head(char *head_str0, int m_items)
 
 void print_menu_help(int xpos, int ypos, int fc, int bc)
 {
-    lcd_putstring(calcx(xpos), calcy(ypos), "(K1) Next", 1, fc, bc);
-	lcd_putstring(calcx(xpos), calcy(ypos + 1), "(K2) OK", 1, fc, bc);
-	lcd_putstring(calcx(xpos), calcy(ypos + 2), "(K3) Quit Menu", 1,  fc, bc);
+    lcd_putstring_P(calcx(xpos), calcy(ypos), PSTR("(K1) Next"), 1, fc, bc);
+	lcd_putstring_P(calcx(xpos), calcy(ypos + 1), PSTR("(K2) OK"), 1, fc, bc);
+	lcd_putstring_P(calcx(xpos), calcy(ypos + 2), PSTR("(K3) Quit Menu"), 1,  fc, bc);
 }
 
 void print_menu_item(int m, int i, int invert)
 {
-	char *menu_str[MENUITEMS][10] =    {{"160m   ", "80m    ", "40m    ", "20m    ", "15m    ", "10m    "},
+	static const char menu_str[MENUITEMS][6][8] PROGMEM = {{"160m   ", "80m    ", "40m    ", "20m    ", "15m    ", "10m    "},
 		                                {"LSB    ", "USB    ", "       ", "       ", "       ", "       "},
 		                                {"VFO A  ", "VFO B  ", "A=B    ", "B=A    ", "       ", "       "},
 		                                {"OFF    ", "ON     ", "       ", "       ", "       ", "       "}, 
@@ -2767,7 +3650,7 @@ void print_menu_item(int m, int i, int invert)
 		bc = DARK_BLUE2;
 	}
 	
-	lcd_putstring(calcx(xpos1), calcy(i + 2), menu_str[m][i], 1, fc, bc);
+	lcd_putstring_P(calcx(xpos1), calcy(i + 2), menu_str[m][i], 1, fc, bc);
 }
 	
 //Print the itemlist or single item
@@ -2797,11 +3680,11 @@ int navigate_thru_item_list(int m, int maxitems, int curitem, int cvfo, int cban
 	int menu_pos_old = 0;
 	//print_menu_item_list(m, menu_pos, 1);     //Write current entry in REVERSE color
 	
-	int key = get_keys();
+	int key = ui_get_key(UI_SRV_ALL);
 	
     while(key == 0)
 	{
-		if(tuningknob >= 1)  //Turn CW
+		if(knob_get() >= 1)  //Turn CW
 		{
 			print_menu_item(m, menu_pos, 0); //Write old entry in normal color
 		    if(menu_pos < maxitems)
@@ -2813,10 +3696,10 @@ int navigate_thru_item_list(int m, int maxitems, int curitem, int cvfo, int cban
 				menu_pos = 0;
 			}
 			print_menu_item(m, menu_pos, 1); //Write new entry in reverse color
-		    tuningknob = 0;
+		    knob_ack(1);
 		}
 
-		if(tuningknob <= -1) //Turn CCW
+		if(knob_get() <= -1) //Turn CCW
 		{    
 		    print_menu_item(m, menu_pos, 0); //Write old entry in normal color
 		    if(menu_pos > 0)
@@ -2828,7 +3711,7 @@ int navigate_thru_item_list(int m, int maxitems, int curitem, int cvfo, int cban
 				menu_pos = maxitems;
 			}
 			print_menu_item(m, menu_pos, 1); //Write new entry in reverse color
-		    tuningknob = 0;
+		    knob_ack(-1);
 		}	
 		
 		//Make settings audible
@@ -2857,10 +3740,9 @@ int navigate_thru_item_list(int m, int maxitems, int curitem, int cvfo, int cban
 		    menu_pos_old = menu_pos;
 		}    
 				
-		key = get_keys();
+		key = ui_get_key(UI_SRV_ALL);
 	}
 		
-	while(get_keys());
 	set_frequency1(f_vfo[cvfo]);
 	switch(key)
 	{   case 1: return -1;       //Next menu!
@@ -2891,13 +3773,12 @@ long menu0(long f, int c_vfo, int c_band)
 	int x, y, c = 0;
 	int key = 0;
 	
-	char menu_str[MENUITEMS][10] = {"BAND    ", "SIDEBAND", "VFO     ", "ATT     ", "TONE    ", "AGC     ", "MEMORIES", "SCAN    ", "SPLIT   ", "LO ADJST", "SPECIAL "};
+	static const char menu_str[MENUITEMS][9] PROGMEM = {"BAND    ", "SIDEBAND", "VFO     ", "ATT     ", "TONE    ", "AGC     ", "MEMORIES", "SCAN    ", "SPLIT   ", "LO ADJST", "SPECIAL "};
 	
-	while(get_keys());
 	
 	lcd_cls(bcolor);
 	
-	lcd_putstring(calcx(0), calcy(1), "       MENU SELECT       ", 1, DARK_BLUE1, LIGHT_GRAY);
+	lcd_putstring_P(calcx(0), calcy(1), PSTR("       MENU SELECT       "), 1, DARK_BLUE1, LIGHT_GRAY);
 	
 	//Draw init screen
 	for(y = 0; y < 6; y++)
@@ -2906,7 +3787,7 @@ long menu0(long f, int c_vfo, int c_band)
 		{
 			if(c < MENUITEMS)
 			{
-			    lcd_putstring(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], 1, WHITE, DARK_BLUE2);
+			    lcd_putstring_P(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], 1, WHITE, DARK_BLUE2);
 			    c++;
 			}    
 		}
@@ -2918,50 +3799,50 @@ long menu0(long f, int c_vfo, int c_band)
 	
 	drawbox(10, 46, 275, 176, WHITE);
 	
-	lcd_putstring(calcx(1), calcy(12), "(K2) OK" "(K3) Quit Menu", 1,  LIGHT_GRAY, bcolor);
+	lcd_putstring_P(calcx(1), calcy(12), PSTR("(K2) OK" "(K3) Quit Menu"), 1,  LIGHT_GRAY, bcolor);
 	
 	//Highlight 1st item
-	lcd_putstring(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], 1, DARK_BLUE2, WHITE);
+	lcd_putstring_P(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], 1, DARK_BLUE2, WHITE);
 		
 	//Select item
 	while(!key)
 	{
 		
-		if(tuningknob >= 1)  
+		if(knob_get() >= 1)  
 		{
 			if(c < MENUITEMS - 1)
 			{   
 				y = c / 2;
 			    x = c - (y * 2);
-			    lcd_putstring(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], 1, WHITE, DARK_BLUE2);
+			    lcd_putstring_P(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], 1, WHITE, DARK_BLUE2);
 				
 				c++; 
 		        
 		        y = c / 2;
 			    x = c - (y * 2);
-			    lcd_putstring(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], 1, DARK_BLUE2, WHITE);
+			    lcd_putstring_P(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], 1, DARK_BLUE2, WHITE);
 			}   
-			tuningknob = 0;  
+			knob_ack(1);  
 		}	
 		
-		if(tuningknob <= -1)  
+		if(knob_get() <= -1)  
 		{   
 			if(c > 0)
 			{    
 				y = c / 2;
 			    x = c - (y * 2);
-			    lcd_putstring(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], 1, WHITE, DARK_BLUE2);
+			    lcd_putstring_P(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], 1, WHITE, DARK_BLUE2);
 			    
 			    c--;
 		        
 		        y = c / 2;
 			    x = c - (y * 2);
-			    lcd_putstring(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], 1, DARK_BLUE2, WHITE);
+			    lcd_putstring_P(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], 1, DARK_BLUE2, WHITE);
 			}    
-			tuningknob = 0; 
+			knob_ack(-1); 
 		}	
 		
-		key = get_keys();
+		key = ui_get_key(UI_SRV_ALL);
 		
 		switch(key)
 		{
@@ -2972,7 +3853,6 @@ long menu0(long f, int c_vfo, int c_band)
 		}	        
 	}
 	
-	while(get_keys());		
 	
 	return -2; 
 }	
@@ -2982,11 +3862,10 @@ long menu0(long f, int c_vfo, int c_band)
 long menu1(int menu, long f, int c_vfo, int c_band)
 {
 	//                              0       1       2      3       4       5      6      7        8        9        10
-	char menu_str[MENUITEMS][10] = {"BAND", "SIDE", "VFO", "ATT ", "TONE", "AGC", "MEM", "SCAN", "SPLIT", "LO ADJ", "XTRA"};
+	static const char menu_str[MENUITEMS][7] PROGMEM = {"BAND", "SIDE", "VFO", "ATT ", "TONE", "AGC", "MEM", "SCAN", "SPLIT", "LO ADJ", "XTRA"};
 	
 	int result = 0;
 		
-	while(get_keys());    
 	print_menu_head(menu_str[menu], menu_items[menu]);	//Head outline of menu
 	
 	//Navigate thru item list	
@@ -3047,30 +3926,30 @@ int adjustbacklight(void)
 {
 	int key;
 	int val = blight;
-	key = get_keys();
+	key = ui_get_key(UI_SRV_ALL);
 	
 	lcd_cls(bcolor);
 	
-	lcd_putstring(calcx(2), calcy(2), "Backlight Set", 1, YELLOW, bcolor);
+	lcd_putstring_P(calcx(2), calcy(2), PSTR("Backlight Set"), 1, YELLOW, bcolor);
 	lcd_putnumber(calcx(2), calcy(4), val, -1, 1, WHITE, bcolor);	
 	print_menu_help(2, 8, LIGHT_GREEN, bcolor);
 	
 	while(key == 0)
 	{
 		//Set light by changing PWM duty cycle
-        if(tuningknob >= 1)
+        if(knob_get() >= 1)
 		{
 		    if(val < 255)
 		    {
 				val += 1;
 			}	
 			lcd_setbacklight(val);
-			lcd_putstring(calcx(2), calcy(4), ".  ", 1, YELLOW, bcolor);
+			lcd_putstring_P(calcx(2), calcy(4), PSTR(".  "), 1, YELLOW, bcolor);
 			lcd_putnumber(calcx(2), calcy(4), val, -1, 1, WHITE, bcolor);
-			tuningknob = 0;
+			knob_ack(1);
 		}
 
-		if(tuningknob <= -1)  
+		if(knob_get() <= -1)  
 		{    
 		    if(val > 0)
 		    {
@@ -3078,19 +3957,17 @@ int adjustbacklight(void)
 			}
 
 			lcd_setbacklight(val);
-			lcd_putstring(calcx(2), calcy(4), ".  ", 1, YELLOW, bcolor);
+			lcd_putstring_P(calcx(2), calcy(4), PSTR(".  "), 1, YELLOW, bcolor);
 			lcd_putnumber(calcx(2), calcy(4), val, -1, 1, WHITE, bcolor);
-			tuningknob = 0;
+			knob_ack(-1);
 		}			    
-		key = get_keys();
+		key = ui_get_key(UI_SRV_ALL);
 	}	
 	
 	if(key == 2)
 	{
-		cli();
-        while(!eeprom_is_ready());
-        eeprom_write_byte((uint8_t*)482, val);
-        sei();
+        eeprom_store(482, val);
+        TRACE_EEPROM(482, val);
         blight = val;
     }
     else
@@ -3106,8 +3983,8 @@ void tx_test(void)
 	int t1;
 	int key = 0;
 		
-	while(get_keys());
 	PORTA |= 8;
+	trace_put(TR_TX, TR_TX_LOCAL | 1);
 	show_txrx(1);
 	while(key != 1)
 	{
@@ -3116,7 +3993,7 @@ void tx_test(void)
 			if(!t1)
 			{
 				lcd_cls(bcolor);
-	            show_msg("Transmitter test mode", bcolor);
+	            show_msg_P(PSTR("Transmitter test mode"), bcolor);
 	        }
 		    set_band(t1, 0);
 		    set_frequency1(c_freq[t1]);
@@ -3124,23 +4001,21 @@ void tx_test(void)
 		    key = 0;
 		    while(!key)
 		    {
-			    key = get_keys();
+			    key = ui_get_key(UI_SRV_CAT);
 		    }
-		    while(get_keys());
 		    
 		    if(key == 1)
 		    {
 				PORTA &= ~(8); 	
+				trace_put(TR_TX, TR_TX_LOCAL);
 	            show_txrx(0);
-	            while(get_keys());
 	            return;
 	        }       
 		}    
-		while(get_keys());
 	}			
 	PORTA &= ~(8); 	
+	trace_put(TR_TX, TR_TX_LOCAL);
 	show_txrx(0);
-	while(get_keys());
 }	
 
 //Switch TX with dual tone oscillator
@@ -3149,15 +4024,17 @@ void tune(void)
 	int key = 0;
 	
 	PORTA |= 8; //TX on
+	trace_put(TR_TX, TR_TX_LOCAL | 1);
 	set_audio_tone_oscillator(1);
 	show_txrx(1);
 	
 	while(!key)
 	{
-		key = get_keys();
+		key = ui_get_key(UI_SRV_CAT);
 	}
 		
 	PORTA &= ~(8); //TX off
+	trace_put(TR_TX, TR_TX_LOCAL);
 	set_audio_tone_oscillator(0);
 	show_txrx(0);    
 }		
@@ -3170,7 +4047,8 @@ void tune(void)
 long scan(int mode)
 {
     int t1 = 0;
-    long f, df, runsecsold = 0;
+    long f, df;
+    unsigned long tstart;
     int key = 0;
     int sval;
         
@@ -3182,13 +4060,12 @@ long scan(int mode)
     {
 		scan_skip[t1] = 0;
 	}
-	tuningknob = 0;
+	knob_clear();
 	
-    while(get_keys());
     
     if(!mode)
     {
-		show_msg("Scanning Memories...", bcolor);
+		show_msg_P(PSTR("Scanning Memories..."), bcolor);
 		key = 0;
         while(!key) //Scan memories
 	    {
@@ -3207,11 +4084,11 @@ long scan(int mode)
 				    				    
 				    while(sval > s_threshold && !key)
 				    {
-		 	            runsecsold = runseconds10;
-		 	            key = get_keys();
-		 	            while(runseconds10 < runsecsold + 1 && !key)
+		 	            tstart = get_ms();
+		 	            key = ui_get_key(UI_SRV_CAT);
+		 	            while(get_ms() - tstart < T_METER && !key)
 		 	            {
-							key = get_keys();
+							key = ui_get_key(UI_SRV_CAT);
 					    }	
 		 	            sval = get_s_value();
 		 	            smeter(sval, bcolor); //S-Meter
@@ -3219,20 +4096,26 @@ long scan(int mode)
 		 	            if(get_ptt()) //PTT active
 			            {
 				            key = 2;
-				            while(get_ptt());
+				            while(get_ptt()) //Wait for PTT release
+				            {
+				            	ui_get_key(UI_SRV_CAT);
+				            }
 			            }
 		 	        }
 					
-				    runsecsold = runseconds10;
-				    while(runseconds10 < runsecsold + 20 && !key)
+				    tstart = get_ms();
+				    while(get_ms() - tstart < 2000 && !key)
 			        {
-						key = get_keys();
+						key = ui_get_key(UI_SRV_CAT);
 						sval = get_s_value();
 						smeter(sval, bcolor); //S-Meter
 						if(get_ptt()) //PTT active
 			            {
 				            key = 2;
-				            while(get_ptt());
+				            while(get_ptt()) //Wait for PTT release
+				            {
+				            	ui_get_key(UI_SRV_CAT);
+				            }
 			            }
 					}	
 			    } 
@@ -3240,15 +4123,14 @@ long scan(int mode)
 			    {
 					show_mem_number(t1);
 					show_frequency1(0, 0, bcolor);
-					key = get_keys();
+					key = ui_get_key(UI_SRV_CAT);
 				}	
 				
-				while(get_keys());
 				
-				if(tuningknob)
+				if(knob_get())
 				{
 					scan_skip[t1] = 1;
-					tuningknob = 0;
+					knob_clear();
 				}	
 				t1++;
 				reset_smax();
@@ -3256,7 +4138,6 @@ long scan(int mode)
 		}
 		t1--;
 				
-		while(get_keys());
 				
 		if(key == 2)
 		{
@@ -3269,7 +4150,7 @@ long scan(int mode)
 	}
 	else  //Scan band
 	{	
-		show_msg("Scanning Band...", bcolor);				
+		show_msg_P(PSTR("Scanning Band..."), bcolor);				
 	    while(!key) 
 	    {
 			//Load edge frequencies
@@ -3302,15 +4183,15 @@ long scan(int mode)
 			    sval = get_s_value(); //ADC voltage on ADC2 SVAL
 			    smeter(sval, bcolor); //S-Meter
 				
-				key = get_keys();
+				key = ui_get_key(UI_SRV_CAT);
 				
 		 	    while((sval > s_threshold) && !key)
 				{
-					runsecsold = runseconds10;
-		 	        key = get_keys();
-		 	        while(runseconds10 < runsecsold + 1 && !key)
+					tstart = get_ms();
+		 	        key = ui_get_key(UI_SRV_CAT);
+		 	        while(get_ms() - tstart < T_METER && !key)
 		 	        {
-						key = get_keys();
+						key = ui_get_key(UI_SRV_CAT);
 					}	
 		 	        sval = get_s_value();
 		 	        smeter(sval, bcolor); //S-Meter
@@ -3319,21 +4200,23 @@ long scan(int mode)
 			    if(get_ptt()) //PTT active
 			    {
 				    key = 2;
-				    while(get_ptt());
+				    while(get_ptt()) //Wait for PTT release
+				    {
+				    	ui_get_key(UI_SRV_CAT);
+				    }
 			    }
 			}
 		}  
 								
-		while(get_keys());
 				
 		if(key == 2)
 		{
-			show_msg("QRG selected", bcolor);				
+			show_msg_P(PSTR("QRG selected"), bcolor);				
 			return(scanfreq[0] + df); //Set this memory frequency as new operating QRG
 		}
 		else
 		{
-			show_msg("Stopped.", bcolor);				
+			show_msg_P(PSTR("Stopped."), bcolor);				
 			return(-1);
 		}			
 	}				    
@@ -3348,39 +4231,38 @@ long set_scan_frequency(int fpos, long f0)
     long f1 = f0;
     int fcolor = WHITE;
     
-    lcd_putstring(xpos0, ypos0, "SET SCAN FREQ", 1, fcolor, bcolor);
+    lcd_putstring_P(xpos0, ypos0, PSTR("SET SCAN FREQ"), 1, fcolor, bcolor);
     if(!fpos)
     {
-        lcd_putstring(xpos0, ypos0 + 1, "1st FREQUENCY", 1, fcolor, bcolor);
+        lcd_putstring_P(xpos0, ypos0 + 1, PSTR("1st FREQUENCY"), 1, fcolor, bcolor);
     }   
     else
     {
-        lcd_putstring(xpos0, ypos0 + 1, "2nd FREQUENCY", 1, fcolor, bcolor);
+        lcd_putstring_P(xpos0, ypos0 + 1, PSTR("2nd FREQUENCY"), 1, fcolor, bcolor);
     }   
         
     show_frequency1(f1, 1, bcolor);
         	
     while(!key)
     {
-        if(tuningknob >= 1) //Turn CW
+        if(knob_get() >= 1) //Turn CW
 		{
-			f1 += calc_tuningfactor();
+			f1 = tune_step(f1, 1);
 			set_frequency1(f1);
 			show_frequency1(f1, 0, bcolor);
-            tuningknob = 0;
+            knob_ack(1);
 		}
 
-		if(tuningknob <= -1)  //Turn CCW
+		if(knob_get() <= -1)  //Turn CCW
 		{    
-			f1 -= calc_tuningfactor();
+			f1 = tune_step(f1, -1);
 			show_frequency1(f1, 0, bcolor);
             set_frequency1(f1);
-            tuningknob = 0;
+            knob_ack(-1);
 		}		
-		key = get_keys();
+		key = ui_get_key(UI_SRV_ALL);
 	}
 	
-	while(get_keys());
 	
 	if(key == 2)
 	{
@@ -3405,29 +4287,29 @@ void set_scan_threshold(void)
     smeter(thresh, bcolor);
     draw_meter_scale(0, bcolor);
         
-    lcd_putstring(xpos0, ypos0, " SCAN THRESH ", 1, fcolor, bcolor);
+    lcd_putstring_P(xpos0, ypos0, PSTR(" SCAN THRESH "), 1, fcolor, bcolor);
         
-    lcd_putstring(xpos0, ypos0 + 2, "  ", 1, fcolor, bcolor);
+    lcd_putstring_P(xpos0, ypos0 + 2, PSTR("  "), 1, fcolor, bcolor);
     lcd_putnumber(xpos0, ypos0 + 2, thresh, -1, 1, WHITE, bcolor);
     
     	
     while(!key)
     {
-         if(tuningknob >= 1)//Turn CW
+         if(knob_get() >= 1)//Turn CW
 		{
-			if(thresh < 200)
+			if(thresh < SMAX)
 			{
 				thresh++;
 			}
 			smeter(thresh, bcolor);
 	
-            lcd_putstring(xpos0, ypos0 + 2, "   ", 1, fcolor, bcolor);
+            lcd_putstring_P(xpos0, ypos0 + 2, PSTR("   "), 1, fcolor, bcolor);
             lcd_putnumber(xpos0, ypos0 + 2, thresh, -1, 1, fcolor, bcolor);
     
-			tuningknob = 0;
+			knob_ack(1);
 		}
 
-		if(tuningknob <= -1)  //Turn CCW
+		if(knob_get() <= -1)  //Turn CCW
 		{    
 			if(thresh > 0)
 			{
@@ -3435,1068 +4317,3089 @@ void set_scan_threshold(void)
 			}
 			smeter(thresh, bcolor);
 			 
-            lcd_putstring(xpos0, ypos0 + 2, "   ", 1, fcolor, bcolor);
+            lcd_putstring_P(xpos0, ypos0 + 2, PSTR("   "), 1, fcolor, bcolor);
             lcd_putnumber(xpos0, ypos0 + 2, thresh, -1, 1, fcolor, bcolor);
-            tuningknob = 0;
+            knob_ack(-1);
 		}		
-		key = get_keys();
+		key = ui_get_key(UI_SRV_ALL);
 	}
 	
 	if(key == 2)
 	{
 		s_threshold = thresh;
-		eeprom_write_byte((uint8_t*)129, s_threshold);
+		eeprom_store(129, s_threshold);
+		TRACE_EEPROM(129, s_threshold);
 	}	
 	
 }	
 
 
-  //////////////////////////
- //  INTERRUPT HANDLERS  //
-//////////////////////////
-//Rotary encoder
-ISR(INT2_vect)
-{ 
-    tuningknob = ((PIND >> 2) & 0x03) - 2;           // Read PD2 and PD3 and convert to 1 or -1 
-	tuningcount++;
-}
+  ///////////////
+ //  SCRATCH  //
+///////////////
+//Get zeroed buffer of n bytes (max. SCRATCH_SPILL)
+//Buffers are released in reverse order of allocation with scratch_release(),
+//i. e. allocate and release within the same function
+//If the arena is full, the spill buffer is used the same way (nested requests get separate buffers)
+char *scratch_alloc(int n)
+{
+	char *p;
+	int t1;
+	
+	if(n > SCRATCH_SPILL || (scratch_top + n > SCRATCH_SIZE && scratch_spill_top + n > SCRATCH_SPILL))
+	{
+		scratch_fail++;
+		p = scratch_spill;
+		if(n > SCRATCH_SPILL)
+		{
+			n = SCRATCH_SPILL;
+		}
+	}
+	else if(scratch_top + n > SCRATCH_SIZE)
+	{
+		scratch_overflow++;
+		p = scratch_spill + scratch_spill_top;
+		scratch_spill_top += n;
+		if(scratch_spill_top > scratch_spill_hwm)
+		{
+			scratch_spill_hwm = scratch_spill_top;
+		}
+	}
+	else
+	{
+		p = scratch + scratch_top;
+		scratch_top += n;
+		if(scratch_top > scratch_hwm)
+		{
+			scratch_hwm = scratch_top;
+		}
+	}
+	
+	for(t1 = 0; t1 < n; t1++)
+	{
+		p[t1] = 0;
+	}
+	
+	return p;
+}	
 
-ISR(TIMER1_COMPA_vect)
+//Release buffer and all buffers allocated after it
+void scratch_release(char *p)
 {
-	runseconds10++; 
-    tuningcount = 0;
-}
+	if(p >= scratch && p < scratch + SCRATCH_SIZE)
+	{
+		scratch_top = p - scratch;
+	}
+	else if(p >= scratch_spill && p < scratch_spill + SCRATCH_SPILL)
+	{
+		scratch_spill_top = p - scratch_spill;
+	}
+}	
 
-int calc_tuningfactor(void)
+  /////////////
+ //  STACK  //
+/////////////
+//Runs from .init1 before C runtime is set up, so no C code here
+#ifdef __AVR__
+void stack_paint(void)
 {
-	return (tuningcount * tuningcount  * tuningcount);
+	__asm volatile ("    ldi r30, lo8(_end)\n"
+	                "    ldi r31, hi8(_end)\n"
+	                "    ldi r24, %0\n"
+	                "    ldi r25, hi8(__stack)\n"
+	                "    rjmp 2f\n"
+	                "1:  st Z+, r24\n"
+	                "2:  cpi r30, lo8(__stack)\n"
+	                "    cpc r31, r25\n"
+	                "    brlo 1b\n"
+	                "    breq 1b\n" :: "i" (STACK_CANARY));
 }	
+#endif
 
-  ///////////////////
- //// U A R T   ////
-///////////////////
-void usart_init(int baudrate)
+//Bytes between end of .bss and deepest stack usage so far
+unsigned int stack_free(void)
 {
-		
-    /* Set baud rate */
-	UBRR0H = (unsigned char)(baudrate >> 8);
-	UBRR0L = (unsigned char)baudrate;
+	uint8_t *p = &_end;
+	unsigned int n = 0;
 	
-	/* Enable receiver and transmitter */
-	UCSR0B = (1<<RXEN)|(1<<TXEN);
+	while(p <= &__stack && *p == STACK_CANARY)
+	{
+		p++;
+		n++;
+	}
 	
-	/* Set frame format: 8data, 1stop bit, NO parity */
-	UCSR0C = (1 << UCSZ00)|(1 << UCSZ01);
-		
-}
+	return n;
+}	
 
-	
-void usart_transmit(unsigned char data)
-{
-	/* Wait for empty transmit buffer */
-	while(!(UCSR0A & (1<<UDRE)));
-	/* Put data into buffer, sends the data */
-	UDR0 = data;
-}
+  ////////////////
+ //  TIMEBASE  //
+////////////////
+//Data shared with ISRs is only accessed by these functions outside of interrupt handlers
+//Multi-byte values are read and modified with interrupts off, previous I flag is restored (safe in cli sections)
 
-int usart_receive(void)
+//Milliseconds since power on
+unsigned long get_ms(void)
 {
-	/* Wait for data to be received */
-	if(UCSR0A & (1<<RXC))
+	unsigned long ms;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 	{
-		/* Get and return received data from buffer */
-	    return UDR0;
+		ms = ms_ticks;
 	}
-	else
-	{
-		return -1;
-	}	    
-}
+	
+	return ms;
+}	
 
-void usart_sendstring(char *s)
+//Encoder detents not handled yet: > 0 CW, < 0 CCW
+int knob_get(void)
 {
-	int t1 = 0;
+	int n;
 	
-	while(s[t1])
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 	{
-		usart_transmit(s[t1++]);
+		n = tuningknob;
 	}
-}		
- 
-void usart_send_crlf(void)
-{
-	usart_transmit(13);
-	usart_transmit(10);
+	
+	return n;
 }	
 
-	
-int main(void)
+//One detent in direction dir (1 or -1) has been handled, edges arriving meanwhile are kept
+void knob_ack(int dir)
 {
-	int t1;
-    int tmp0, tmp1;
-    	
-	cur_agc = 1;
-	cur_tone = 1;
-	int key;
-	long rval = 0;
-	
-	int adcval;
-	
-	long runseconds10s = 0;     //Ms counter for displaying S-Value 
-	long runseconds10speak = 0; //Ms counter for resetting peak value of S-Meter
-	long runseconds10msg = 0;   //Ms for holding message displayed
-	long runseconds10volts = 0; //Ms for voltage check
-	
-	int sval = 0;
-	int cur_vfo = 0, alt_vfo = 1;
-	
-	//CAT interface
-	char *buf1, *buf2, *buf3, *buf4;
-	char ch;
-	int cnt = 0;
-		
-	double v1;
-	
-	long freq_temp0 = 0;      
-	long freq_temp1 = 0;    
-		
-    LCDCTRLDDR = 0xF0; //LCD CTRL PA4:PA7 blue, brown, violet, green
-    LCDDATADDR = 0xFF; //LCD DATA PC0:PC7
-    
-    _delay_ms(100);
-    
-    //Relays for band set PA0, PA1, PA2
-    DDRA |= 0x07;
-    
-    //PA3 TX relay output
-    DDRA |= 0x08;
-    PORTA &= ~(8); 		 //Set to RX mode
-    
-    //DDS1
-    DDS1_DDR = 0xF0; //DDS1 on PD4:PD7
-    
-    //DDS2
-    DDS2_DDR = 0xF0; //DDS2 on PB4:PB7
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		tuningknob -= dir;
+	}
+}	
 
-    //PB0 for ATT
-    DDRB |= (1 << 3);
-    
-    DDRG = 0x1B; //Set: AGC (PG0:PG1), Tone (PG3:PG4)
-    
-    //ADC0 Pullup resistor
-    ADC_KEY_PORT = 0x01; //ADC        
-    
-    //ROTARY ENCODER
-    PORTD |= (1 << PD2) | (1 << PD3);//INPUT: Pullup resistors for PD2 and PD3 rotary encoder
-    
-    PORTG |= 4; //Pullup for TX/RX indicator
-        
-    //Timer 1 as counter for 10th seconds
-    TCCR1A = 0;             // normal mode, no PWM
-    TCCR1B = (1 << CS10) | (1 << CS12) | (1<<WGM12);   // Prescaler = 1/1024 based on system clock 16 MHz
-                                                       // 15625 incs/sec
-                                                       // and enable reset of counter register
-	OCR1AH = (1562 >> 8);                             //Load compare values to registers
-    OCR1AL = (1562 & 0x00FF);
-	TIMSK |= (1<<OCIE1A);
-		
-	// Timer 3 PWM for display light
-    TCCR3A |= (1<<COM3A1) | (1<<COM3A0) | (1<<WGM30); // 8-bit PWM phase-correct
-    TCCR3B |= (1<<CS30); // No prescale
-    DDRE |= (1<<3);
-    	
-	//Interrupt definitions for rotary encoder  
-	EIMSK = (1<<INT2); // | (1<<INT3));  //enable encoder pins as interrupt source
-	EICRA = (1<<ISC20)|(1<<ISC21);                      // enable pin change interupts  
-    
-    //Reset DDS1 (AD9951)
-    DDS1_PORT |= (DDS1_RESETPIN); 
-    _delay_ms(100); 
-	DDS1_PORT &= ~(DDS1_RESETPIN);          
-    _delay_ms(100); 
-	DDS1_PORT |= (DDS1_RESETPIN);     
-         
-	//Display init
-	LCDCTRLPORT |= LCDRES;     //1
-    _delay_ms(5);
-	LCDCTRLPORT &= ~(LCDRES);  //0
-	_delay_ms(5);
-    LCDCTRLPORT |= LCDRES;     //1
-    _delay_ms(5);
+//Discard all pending detents
+void knob_clear(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		tuningknob = 0;
+	}
+}	
 
-	lcd_init();
-	_delay_ms(100);
-	lcd_cls(bcolor);
-	_delay_ms(100);
+//Start software timer: First expiry after ms, then every period ms (0 = one-shot)
+//Returns timer number or -1 if no slot is free
+int timer_start(void (*cb)(void), unsigned int ms, unsigned int period)
+{
+	int t1;
 	
-	//Init TWI
-    twi_init();
-    
-	//UART init
-	usart_init(UARTBAUDSET);
-
-    //ADC config and ADC init
-    ADCSRA = (1<<ADPS0) | (1<<ADPS1) | (1<<ADEN); //Prescaler 64 and ADC on
-	get_adc(0); //One dummy conversion
-        	    
-	//Load start values
-	//Load last band used
-	cur_band = load_last_band();
-	if(cur_band == -1)
+	for(t1 = 0; t1 < TIMER_MAX; t1++)
 	{
-		cur_band = 2; //Set 40m as default
-	}
-	    
-	sideband = std_sideband[cur_band];
-		
-	//Load VFO data and VFO number
-    cur_vfo = load_last_vfo();
-    if(cur_vfo < 0 || cur_vfo > 1)
-    {
-		cur_vfo = 0;
-		alt_vfo = 1;
+		if(!timer_cb[t1])
+		{
+			timer_due[t1] = get_ms() + ms;
+			timer_period[t1] = period;
+			timer_cb[t1] = cb;
+			return t1;
+		}
 	}
 	
-	set_band(cur_band, cur_vfo);
-	
-	if(cur_vfo)
+	return -1;
+}	
+
+//Rearm timer, next expiry after ms
+void timer_restart(int tmr, unsigned int ms)
+{
+	if(tmr >= 0)
 	{
-		alt_vfo = 0;
+		timer_due[tmr] = get_ms() + ms;
 	}
-	else
+}	
+
+void timer_stop(int tmr)
+{
+	if(tmr >= 0)
 	{
-		alt_vfo = 1;
-	}	
-	    
-	//Load valid frequency if possible int0 2 VFOs
-	for(t1 = 0; t1 < 2; t1++)
-	{   
-	    freq_temp0 = load_frequency0(cur_band + 96 + t1); 
-        //Check if freq is OK
-        if(is_mem_freq_ok(freq_temp0, cur_band))
-        {
-	         f_vfo[t1] = freq_temp0;
-	    }
-	    else
-	    {
-	        f_vfo[t1] = c_freq[cur_band];
-	    }
-	}    
-	    
-    //Load last stored freqeuncy
-    //Check if memory place is not a random number anywhere in EEPROM
-    last_memplace = load_last_mem();
-    if(last_memplace < 0 || last_memplace > 15)
-    {
-		last_memplace = 0;
+		timer_cb[tmr] = 0;
 	}
+}	
+
+//Run callbacks of expired timers
+void timer_poll(void)
+{
+	int t1;
+	unsigned long ms = get_ms();
+	void (*cb)(void);
 	
-	//Load LO frequencies if available
-    for(t1 = 0; t1 < 2; t1++)
-    {
-		f_lo[t1] = load_frequency1(512 + t1 * 4);
-		if((f_lo[t1] < F_LO_LSB - 4000) || (f_lo[t1] > F_LO_USB + 4000))
+	for(t1 = 0; t1 < TIMER_MAX; t1++)
+	{
+		cb = timer_cb[t1];
+		if(cb && (long) (ms - timer_due[t1]) >= 0)
 		{
-			if(!t1)
+			if(timer_period[t1])
 			{
-			    f_lo[t1] = F_LO_LSB;
-			}   
+				timer_due[t1] += timer_period[t1];
+				if((long) (ms - timer_due[t1]) >= 0) //Late by more than one period (e. g. menu open), don't catch up
+				{
+					timer_due[t1] = ms + timer_period[t1];
+				}
+			}
 			else
 			{
-			    f_lo[t1] = F_LO_USB;
-			}   
+				timer_cb[t1] = 0;
+			}
+			cb();
 		}
-	}		
-			
-    for(t1 = 0; t1 < 5; t1++)
-    {
-		set_frequency1(f_vfo[cur_vfo]);
-		set_frequency2(f_lo[sideband]);
-        _delay_ms(10);
-    }
+	}
+}		
 
-	
-	//Load scan threshold
-    s_threshold = eeprom_read_byte((uint8_t*)129);          	
-    if(s_threshold < 0 || s_threshold > 255)
-    {
-		s_threshold = 100;
+//S-Val resp. PWR value
+void meter_timer(void)
+{
+	if(!txrx)
+	{
+		smeter(get_s_value(), bcolor); //S-Meter
 	}
-	
-	//Load scan edge frequencies
-	scanfreq[0] = load_frequency0(108);
-	if(!is_mem_freq_ok(scanfreq[0], cur_band))
+	else
 	{
-		scanfreq[0] = band_f0[cur_band];
-		scanfreq[1] = band_f1[cur_band];
-	}	
+		smeter(get_adc(1), bcolor); //*0.5
+	}    
+}	
+
+//Delete peak value of meter
+void peak_timer(void)
+{
+	reset_smax();
+}	
+
+//Clear message line
+void msg_timer(void)
+{
+	show_msg_P(PSTR(""), bcolor);
+	show_msg_P(PSTR("(K1) Menu (K3) Xtra func"), bcolor);
+}	
+
+void temp_timer(void)
+{
+	show_temp(bcolor);
+}	
+
+void volts_timer(void)
+{
+	show_voltage(bcolor);
+}	
+
+  /////////////////
+ //  SCHEDULER  //
+/////////////////
+//Register task: Lower prio value = higher priority, period 0 = run on every pass
+//Budget is the intended max. run time in us, violations are counted
+void sched_add(void (*fn)(void), int prio, unsigned int period, unsigned int budget)
+{
+	int t1;
 	
-	//Split default setting TXA RXB
-	vfo_s[0] = 0;
-	vfo_s[1] = 1;
-    
-    if(is_mem_freq_ok(load_frequency0(last_memplace), cur_band))
+	if(task_cnt >= TASK_MAX)
 	{
-		show_mem_freq(load_frequency0(last_memplace), bcolor);
+		return;
 	}
-	else
-	{	
-		show_mem_freq(0, bcolor);	
+	
+	//Keep table sorted by priority
+	for(t1 = task_cnt; t1 > 0 && task_prio[t1 - 1] > prio; t1--)
+	{
+		task_fn[t1] = task_fn[t1 - 1];
+		task_prio[t1] = task_prio[t1 - 1];
+		task_period[t1] = task_period[t1 - 1];
+		task_budget[t1] = task_budget[t1 - 1];
+		task_due[t1] = task_due[t1 - 1];
 	}	
-          
-	//Load sets
-	// 480: TONE set
-    // 481: AGC set
-	cur_tone = eeprom_read_byte((uint8_t*)480);
-	if(cur_tone < 0 ||cur_tone > 3)
+	
+	task_fn[t1] = fn;
+	task_prio[t1] = prio;
+	task_period[t1] = period;
+	task_budget[t1] = budget / T1_US;
+	task_due[t1] = get_ms() + period;
+	task_cnt++;
+}	
+
+//Run task and record its run time
+void sched_exec(int tsk)
+{
+	unsigned int t0 = TCNT1, dt;
+	unsigned long ms = get_ms();
+	
+	task_fn[tsk]();
+	
+	dt = TCNT1 - t0;
+	if(get_ms() - ms > T1_WRAP_MS) //Timer1 has wrapped (blocking screen)
 	{
-		cur_tone = 1;
+		dt = 0xFFFF;
 	}	
-	show_tone(cur_tone, bcolor);
-	set_tone(cur_tone);
 	
-	cur_agc = eeprom_read_byte((uint8_t*)481);
-	if(cur_agc < 0 || cur_agc > 3)
+	if(dt > task_wcet[tsk])
 	{
-		cur_agc = 2;
+		task_wcet[tsk] = dt;
 	}
-	show_agc(cur_agc, bcolor);
-	set_agc(cur_agc);
 	
-	cur_att = eeprom_read_byte((uint8_t*)483);
-    if(cur_att < 0 || cur_att > 1)
-    {
-		cur_att = 0;
-	}	
-    set_att(cur_att);
-    
-    show_all_data(f_vfo[cur_vfo], f_vfo[alt_vfo], 0, sideband, 0, cur_vfo, 0, 0, 0, 0, last_memplace, txrx);
-    
-    //CAT variables, buffers etc.
-    buf1 = malloc(MAXRXBUFLEN);
-    buf2 = malloc(MAXRXBUFLEN);
-    buf3 = malloc(MAXRXBUFLEN);
-    buf4 = malloc(MAXRXBUFLEN);
-    
-    for(t1 = 0; t1 < MAXRXBUFLEN; t1++) //Init buffers
+	if(dt > task_budget[tsk] && task_overrun[tsk] < 0xFFFF)
 	{
-	    buf1[t1] = 0;
-	    buf2[t1] = 0;
-	    buf3[t1] = 0;
-	    buf4[t1] = 0;   
+		task_overrun[tsk]++;
 	}	
-	/////////////////////////////////////////////
+}	
+
+//One scheduler pass: All tasks with period 0 plus the most urgent due periodic task,
+//so the service interval of the fast tasks is bounded by the longest single periodic task
+void sched_run(void)
+{
+	int t1, periodic_done = 0;
+	unsigned int t0 = TCNT1, dt;
+	unsigned long ms = get_ms(), late;
 	
-	//baCKLIGHT
-    blight = eeprom_read_byte((uint8_t*)482);
-    if(blight < 0 || blight > 255)
-    {
-		blight = 128;
-	}	
-    lcd_setbacklight(blight);
-    
-    lcd_putnumber(calcx(0), calcy(14), f_lo[sideband], -1, 1, WHITE, bcolor);
-            
-    //Load TX preset values
-    for(t1 = 0; t1 < 6; t1++)
-    {
-		tx_preset[t1] = load_tx_preset(t1);
+	PROF_START(PROF_LOOP);
+	wdt_reset();
+	
+	//Main loop jitter: Time between two passes
+	dt = t0 - sched_last;
+	if(ms - sched_last_ms > T1_WRAP_MS)
+	{
+		dt = 0xFFFF;
 	}	
-	//Load TX preset
-	mcp4725_set_value(load_tx_preset(cur_band)); 
-    
-    sei();
-        
-    for(;;) 
+	if(dt > sched_loop_max)
 	{
-		//TUNING		
-		if(tuningknob >= 1 && !txrx)
-		{    
-		    f_vfo[cur_vfo] += calc_tuningfactor();  
-		    set_frequency1(f_vfo[cur_vfo]);
-		    tuningknob = 0;
-		    show_frequency1(f_vfo[cur_vfo], 0, bcolor);
-		}
-		
-		if(tuningknob <= -1 && !txrx)  
+		sched_loop_max = dt;
+	}
+	sched_last = t0;
+	sched_last_ms = ms;
+	
+	for(t1 = 0; t1 < task_cnt; t1++)
+	{
+		if(!task_period[t1])
 		{
-		    f_vfo[cur_vfo] -= calc_tuningfactor();  
-		    set_frequency1(f_vfo[cur_vfo]);
-		    tuningknob = 0;
-			show_frequency1(f_vfo[cur_vfo], 0, bcolor);
+			sched_exec(t1);
 		}
-				
-		//MENU
-		key = get_keys();	
-			
-        switch(key)
-		{
-		    case 1:	rval = menu0(f_vfo[cur_vfo], cur_vfo, cur_band);
-		            key = 0;
-			        
-			        //BAND
-			        //////
-			        if(rval >= 0 && rval < 6)
-			        {
-						//last_freq[cur_band] = f_vfo[cur_vfo];
-			            cur_band = rval;
-			            set_band(cur_band, cur_vfo);
-			        }   
-			        
-			        //SIDEBAND
-			        //////////
-			        if(rval == 10 || rval == 11) //LSB or USB
-			        {
-			            sideband = rval - 10;
-			            set_frequency1(f_vfo[cur_vfo]);
-			            set_frequency2(f_lo[sideband]);
-			        }    
-			        
-			        //VFO
-			        /////
-			        if(rval == 20 || rval == 21) //VFO A or VFO B set
-			        {
-						alt_vfo = cur_vfo;
-						cur_vfo = rval - 20;
-						if(!set_vfo(rval - 20))
-						{
-							cur_vfo = alt_vfo;
-						}	
-				    }    
-			        
-			        if(rval == 22)
-			        {
-						f_vfo[0] = f_vfo[1]; //VFO A = VFO B
-				    }
-				    
-				    if(rval == 23)
-			        {
-						f_vfo[1] = f_vfo[0]; //VFO B = VFO A
-				    }
-				    
-				    //ATT, TONE and AGC
-				    if(rval >= 30 && rval <= 32)
-				    {
-						cur_att = rval - 30;
-						show_att(cur_att, bcolor);
-						set_att(cur_att);
-					}
-					
-				    if(rval >= 40 && rval <= 44)
-				    {
-						cur_tone = rval - 40;
-						show_tone(cur_tone, bcolor);
-						set_tone(cur_tone);
-					}
-					
-					if(rval >= 50 && rval <= 54)
-				    {
-						cur_agc = rval - 50;
-						show_agc(cur_agc, bcolor);
-						set_agc(cur_agc);
-					}
-						
-				    /////////////////////
-				    //MEMORY, SCAN, SPLIT
-				    /////////////////////
-				    switch(rval)
-				    {
-				        case 60:t1 = save_mem_freq(f_vfo[cur_vfo], last_memplace); //Store
-					            if(t1 > -1)
-					            {
-									store_frequency0(f_vfo[cur_vfo], 16 + cur_vfo);
-									last_memplace = t1;
-									store_last_mem(t1);
-					    		}    
-					    		show_frequency1(f_vfo[cur_vfo], 0, bcolor);
-					            set_frequency1(f_vfo[cur_vfo]);
-					            set_frequency2(f_lo[sideband]);
-					            break;
-					            
-					    case 61:freq_temp1 = recall_mem_freq(0);     //Recall QRG  
-					            if(is_mem_freq_ok(freq_temp1 & 0x0FFFFFFF, cur_band) ) //Separate freq from mem_place
-					            {
-									last_memplace = (freq_temp1 >> 28) & 0x0F;
-								    f_vfo[cur_vfo] = freq_temp1  & 0x0FFFFFFF;
-									set_frequency1(f_vfo[cur_vfo]);
-									show_frequency1(f_vfo[cur_vfo], 1, bcolor);
-									show_mem_freq(f_vfo[cur_vfo], bcolor);
-									freq_temp1 &= 0x0FFFFFFF;
-								}	
-								else
-								{
-								    set_frequency1(f_vfo[cur_vfo]);
-								    show_frequency1(f_vfo[cur_vfo], 1, bcolor);
-								}	
-								break;
-					
-				        case 70:t1 = scan(0); //Scan MEMs
-				                if(t1 > 0)
-				                {
-					                freq_temp0 = load_frequency0(t1);
-					                if(is_mem_freq_ok(freq_temp0, cur_band))
-					                {
-									    f_vfo[cur_vfo] = freq_temp0;
-								    }	
-								 }   
-								 set_frequency1(f_vfo[cur_vfo]);
-								 set_frequency2(f_lo[sideband]);
-					            break;
-					    
-					    case 71:freq_temp0 = scan(1); //Scan BAND
-					            if(is_mem_freq_ok(freq_temp0, cur_band))
-					            {
-									f_vfo[cur_vfo] = freq_temp0;
-								}	
-								set_frequency1(f_vfo[cur_vfo]);
-								set_frequency2(f_lo[sideband]);
-								break;
-					                  
-					    case 72:lcd_cls(bcolor); //Set scan frequencies
-					            //Load from EEPROM
-					            for(t1 = 0; t1 < 2; t1++)
-					            {
-					                scanfreq[t1] = load_frequency1(cur_band * 2 + 550 + t1 * 4);
-					                if(!is_mem_freq_ok(scanfreq[t1], cur_band))
-					                {
-										if(!t1)
-										{
-									        scanfreq[t1] = band_f0[cur_band] + 100;
-									    }
-									    else    
-									    {
-									        scanfreq[t1] = band_f1[cur_band] - 100;
-									    }
-								    }	
-								}
-								
-					            scanfreq[0] = set_scan_frequency(0, scanfreq[0]);
-					            scanfreq[1] = set_scan_frequency(1, scanfreq[1]); 
-					            
-					            if(scanfreq[1] < scanfreq[0]) //Change freq order if f0 > f1
-					            {
-									freq_temp0 = scanfreq[1];
-									scanfreq[1] = scanfreq[0];
-									scanfreq[0] = freq_temp0;
-								}
-								
-								//Store in EEPROM
-								for(t1 = 0; t1 < 2; t1++)
-								{
-								    store_frequency1(cur_band * 2 + 550 + t1 * 4, scanfreq[t1]);
-								}
-								
-					            break;
-					                
-					    case 73:set_scan_threshold();            
-					            break;
-					    
-					    //SPLIT mode        
-					    case 80: split = 1;
-					             vfo_s[0] = 0;  //TXA RXB
-					             vfo_s[1] = 1;
-					             break;               
-					             
-					    case 81: split = 2;
-					             vfo_s[0] = 1;  //TXA RXB
-					             vfo_s[1] = 0;
-					             break;               
-					             
-					    case 82: split = 0;
-					             show_split(0, bcolor);
-					             break;   
-					    
-					    case 90: set_lo_freq(0);
-					             break;         
-					             
-					    case 91: set_lo_freq(1);
-					             break;         
-					             
-					    case 100: adjustbacklight();
-					             break;          
-					    
-					    case 101: tx_test();
-					             set_frequency1(f_vfo[cur_vfo]);
-					             show_frequency1(f_vfo[cur_vfo], 1, bcolor);
-					             set_band(cur_band, cur_vfo);
-					             txrx = 0;
-					             break;                   
-					    case 102: tune();         
-					             break;
-					    case 103: tx_preset_adjust();
-					             break;         
-					    case 104: rcv_mem_frequencies();
-					              break;
-			   	        case 105: txm_mem_frequencies();
-					              break;          
-				    }
-				       
-				    lcd_cls(bcolor);    
-			        show_all_data(f_vfo[cur_vfo], f_vfo[alt_vfo], 1, sideband, 0, cur_vfo, 0, 0, 0, 0, last_memplace, txrx);
-			        show_mem_freq(freq_temp1, bcolor);
-			           
-			        while(get_keys());
-			        break;
-			        
-			case 2: store_frequency0(f_vfo[0], cur_band + 96);
-			        store_frequency0(f_vfo[1], cur_band + 97);
-			        store_last_band(cur_band);
-			        store_last_vfo(cur_vfo);
-			        while(get_keys());
-			        show_msg("Frequency data saved.", bcolor);
-			        runseconds10msg = runseconds10;
-			        usart_sendstring("DK7IH QRP MINI6 COMM OK.");
-			        break;
-			        
-			case 3: while(get_keys());
-                    rval = menu1(10, f_vfo[cur_vfo], cur_vfo, cur_band);
-                    switch(rval)
-				    {
-				        case 100: adjustbacklight();
-					             break;          
-					    
-					    case 101: tx_test();
-					             set_frequency1(f_vfo[cur_vfo]);
-					             show_frequency1(f_vfo[cur_vfo], 1, bcolor);
-					             set_band(cur_band, cur_vfo);
-					             txrx = 0;
-					             break;                   
-					    case 102: tune();         
-					             break;
-					    case 103: tx_preset_adjust();
-					             break;   
-                        case 104: rcv_mem_frequencies();
-					              break;
-			   	        case 105: txm_mem_frequencies();
-					              break;          					             
-			        }
-	                lcd_cls(bcolor);    
-			        show_all_data(f_vfo[cur_vfo], f_vfo[alt_vfo], 1, sideband, 0, cur_vfo, 0, 0, 0, 0, last_memplace, txrx);
-			        show_mem_freq(freq_temp1, bcolor);
-			        while(get_keys());
-			        break;      
-		}	            
-		
-		//METER
-		//After 1/5th sec check S-Val resp. PWR value
-		if(runseconds10 > runseconds10s + 1)
+		else
 		{
-			if(!txrx)
-		 	{   sval = get_s_value();
-				smeter((sval >> 1) + (sval >> 2), bcolor); //S-Meter * 1.5
-		 	}
-		 	else
-		 	{
-				adcval = get_adc(1);
-				smeter(adcval, bcolor); //*0.5
-			}    
- 		 	runseconds10s = runseconds10;
- 		}	
- 		
- 		//Delete peak value of meter every 2 seconds
-		if(runseconds10 > runseconds10speak + 20)
+			ms = get_ms();
+			if(!periodic_done && (long) (ms - task_due[t1]) >= 0)
+			{
+				late = ms - task_due[t1];
+				if(late > 0xFFFF)
+				{
+					late = 0xFFFF;
+				}	
+				if(late > task_late[t1])
+				{
+					task_late[t1] = late;
+				}
+				
+				task_due[t1] += task_period[t1];
+				if((long) (ms - task_due[t1]) >= 0) //Don't catch up after a long delay
+				{
+					task_due[t1] = ms + task_period[t1];
+				}
+				
+				sched_exec(t1);
+				periodic_done = 1;
+			}
+		}
+	}
+	
+	PROF_STOP(PROF_LOOP);
+	
+	idle_sleep();
+}	
+
+//Sleep until next interrupt (1ms tick, encoder, UART, ADC) if no input is pending
+//PTT is polled, so it is seen within 1ms
+void idle_sleep(void)
+{
+	unsigned int t0, dt;
+	
+	cli();
+	if(tuningknob || key_q_head != key_q_tail || uart_rx_head != uart_rx_tail)
+	{
+		sei();
+		return;
+	}
+	
+	t0 = TCNT1;
+	sleep_enable();
+	sei();         //Executed before any pending interrupt, so no wake-up can be missed
+	sleep_cpu();
+	sleep_disable();
+	dt = TCNT1 - t0;
+	
+	//Account in ms
+	dt += sleep_acc;
+	while(dt >= 1000 / T1_US)
+	{
+		dt -= 1000 / T1_US;
+		sleep_ms++;
+	}
+	sleep_acc = dt;
+}	
+
+//Send task statistics: prio period(ms) wcet(us) budget(us) overruns max. lateness(ms), last line = max. loop time (us)
+void sched_report(void)
+{
+	int t1;
+	char buf[12];
+	
+	for(t1 = 0; t1 < task_cnt; t1++)
+	{
+		int2asc(task_prio[t1], -1, buf, 12);
+		usart_sendstring(buf);
+		usart_transmit(' ');
+		int2asc(task_period[t1], -1, buf, 12);
+		usart_sendstring(buf);
+		usart_transmit(' ');
+		int2asc((long) task_wcet[t1] * T1_US, -1, buf, 12);
+		usart_sendstring(buf);
+		usart_transmit(' ');
+		int2asc((long) task_budget[t1] * T1_US, -1, buf, 12);
+		usart_sendstring(buf);
+		usart_transmit(' ');
+		int2asc(task_overrun[t1], -1, buf, 12);
+		usart_sendstring(buf);
+		usart_transmit(' ');
+		int2asc(task_late[t1], -1, buf, 12);
+		usart_sendstring(buf);
+		usart_send_crlf();
+	}
+	
+	int2asc((long) sched_loop_max * T1_US, -1, buf, 12);
+	usart_sendstring(buf);
+	usart_send_crlf();
+}	
+
+//Clear statistics
+void sched_reset(void)
+{
+	int t1;
+	
+	for(t1 = 0; t1 < task_cnt; t1++)
+	{
+		task_wcet[t1] = 0;
+		task_overrun[t1] = 0;
+		task_late[t1] = 0;
+	}
+	sched_loop_max = 0;
+}	
+
+#if PROF_ENABLE
+  ////////////////
+ //  PROFILER  //
+////////////////
+//Add one measurement (Timer1 counts), also called from ISR for its own section
+void prof_add(int sect, unsigned int dt)
+{
+	if(prof_cnt[sect] == 0xFFFF) //Full, keep average valid
+	{
+		return;
+	}
+	
+	if(!prof_cnt[sect] || dt < prof_min[sect])
+	{
+		prof_min[sect] = dt;
+	}
+	
+	if(dt > prof_max[sect])
+	{
+		prof_max[sect] = dt;
+	}
+	
+	prof_sum[sect] += dt;
+	prof_cnt[sect]++;
+}	
+
+//Send "name min max avg count" per section, times in CPU cycles
+void prof_report(void)
+{
+	int t1;
+	unsigned int mn, mx, n;
+	unsigned long sum;
+	char buf[12];
+	
+	for(t1 = 0; t1 < PROF_SECTIONS; t1++)
+	{
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 		{
-			reset_smax();
-			runseconds10speak = runseconds10;				
+			mn = prof_min[t1];
+			mx = prof_max[t1];
+			sum = prof_sum[t1];
+			n = prof_cnt[t1];
 		}
 		
-		//Show temperature and clear message line after 10 seconds
-		if(runseconds10 > runseconds10msg + 100)
+		usart_sendstring_P(prof_name[t1]);
+		usart_transmit(' ');
+		int2asc((long) mn * 64, -1, buf, 12);
+		usart_sendstring(buf);
+		usart_transmit(' ');
+		int2asc((long) mx * 64, -1, buf, 12);
+		usart_sendstring(buf);
+		usart_transmit(' ');
+		if(n)
 		{
-			show_temp(bcolor);
-		    runseconds10msg = runseconds10;
-		    
-		    show_msg("", bcolor);
-		    show_msg("(K1) Menu (K3) Xtra func", bcolor);
+			sum = sum / n * 64;
+		}	
+		int2asc(sum, -1, buf, 12);
+		usart_sendstring(buf);
+		usart_transmit(' ');
+		int2asc(n, -1, buf, 12);
+		usart_sendstring(buf);
+		usart_send_crlf();
+	}
+}	
+
+void prof_reset(void)
+{
+	int t1;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		for(t1 = 0; t1 < PROF_SECTIONS; t1++)
+		{
+			prof_min[t1] = 0;
+			prof_max[t1] = 0;
+			prof_sum[t1] = 0;
+			prof_cnt[t1] = 0;
 		}
-		
-		//Measure voltage every 5 secs
-		if(runseconds10 > runseconds10volts + 50)
+	}
+}	
+#endif
+
+  /////////////
+ //  TRACE  //
+/////////////
+//Log one event, safe to call from ISRs
+void trace_put(unsigned char ev, unsigned long arg)
+{
+	unsigned char i;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		i = trace_head;
+		trace_head = (i + 1) & (TRACE_LEN - 1);
+		trace_ms[i] = ms_ticks;
+		trace_ev[i] = ev;
+		trace_arg[i] = arg;
+		if(trace_cnt < TRACE_LEN)
 		{
-		    show_voltage(bcolor);
-		    runseconds10volts = runseconds10;
+			trace_cnt++;
 		}
+	}
+}	
 
-		//Detect PTT
-		if(get_ptt())
+//Send trace, oldest event first, one line per event: "tttt ee aaaaaaaa" (hex)
+//tttt = ms time stamp (16 bit, wraps), ee = event code (TR_xx), aaaaaaaa = argument
+void trace_dump(void)
+{
+	unsigned char t1, i, n, ev;
+	unsigned int ms;
+	unsigned long arg;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		n = trace_cnt;
+		i = (trace_head - n) & (TRACE_LEN - 1);
+	}
+	
+	for(t1 = 0; t1 < n; t1++)
+	{
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 		{
-			if(!txrx)
-		    {
-			    txrx = 1;
-			    show_txrx(txrx);
-                draw_meter_scale(1, bcolor);				
-		    
-    		    switch(split)
-	    	    {
-		    		case 1: set_frequency1(f_vfo[vfo_s[0]]);
-			    	        show_frequency1(f_vfo[vfo_s[0]], 0, bcolor);
-	                        show_frequency2(8, 9, f_vfo[vfo_s[1]], bcolor, 100, 1); 
-				            break;
-				    case 2: set_frequency1(f_vfo[vfo_s[1]]);
-				            show_frequency1(f_vfo[vfo_s[1]], 0, bcolor);
-    				        show_frequency2(8, 9, f_vfo[vfo_s[0]], bcolor, 100, 1); 
-	    			        break;        
-		    		case 0: set_frequency1(f_vfo[cur_vfo]);
-			    	        show_frequency1(f_vfo[cur_vfo], 0, bcolor);        
-			    }        
-			    
-			    PORTA |= (1 << 3); //TX on
-			}   
-	    }
-	    else
-	    {	
-		    if(txrx)
-		    {
-			    txrx = 0;
-			    show_txrx(txrx);
-			    draw_meter_scale(0, bcolor);
-			    
-			    switch(split)
-		        {
-				    case 1: set_frequency1(f_vfo[vfo_s[1]]);
-				            show_frequency1(f_vfo[vfo_s[1]], 0, bcolor);
-	                        show_frequency2(8, 9, f_vfo[vfo_s[0]], bcolor, 100, 1); 
-				            break;
-				    case 2: set_frequency1(f_vfo[vfo_s[0]]);
-				            show_frequency1(f_vfo[vfo_s[0]], 0, bcolor);
-				            show_frequency2(8, 9, f_vfo[vfo_s[1]], bcolor, 100, 1); 
-				            break;        
-				    case 0: set_frequency1(f_vfo[cur_vfo]);
-				            show_frequency1(f_vfo[cur_vfo], 0, bcolor);        
-			    }        
-			    
-			    PORTA &= ~(1 << 3); 		//TX off    
-		    }
-		}   
+			ms = trace_ms[i];
+			ev = trace_ev[i];
+			arg = trace_arg[i];
+		}
 		
-		//Computer aided tuning (CAT)
-		//Fill buf1 string with incoming characters from usart
-		ch = usart_receive();
-		if(ch >= 97 && ch <= 122) //Convert lower case to upper case
-		{
-			ch &= ~0x20;
-		}	
-			
-		//lcd_putnumber(0, 50, ch, -1, 1, YELLOW, DARK_BLUE1);
-		if(ch >= 32 &&ch < 128)
-		{
-			if(cnt < MAXRXBUFLEN)
-			{
-		        buf1[cnt++] = ch;
-			    buf1[cnt] = 0;
-			}    
-		}	
+		usart_sendhex(ms, 4);
+		usart_transmit(' ');
+		usart_sendhex(ev, 2);
+		usart_transmit(' ');
+		usart_sendhex(arg, 8);
+		usart_send_crlf();
+		i = (i + 1) & (TRACE_LEN - 1);
+	}
+}	
 
-	    if(ch == 13) //Command complete
-		{
-			cnt = MAXRXBUFLEN;
-			show_msg(buf1, bcolor);
-			cnt = 0;
-
-            //Check if Command ist "SET" or "GET"
-            get_info_from_string(buf1, buf2, 0); 
-            if(!strcmp(buf2, "SET"))
-            {
-				show_msg("", bcolor);
-				
-			    //Parse buffer string
-			    //Get 2nd Parameter of Message Code (Can be "BAND", "SIDEBAND" etc...
-		        get_info_from_string(buf1, buf2, 1); 
-			
-		        if(!strcmp(buf2, "BAND")) //Band change - |Example: "SET BAND 0"
-		        {
-			        get_info_from_string(buf1, buf3, 2); 
-			        tmp0 = asc2long(buf3);
-			        if((tmp0 >= 0) && (tmp0 < 6))
-			        {
-    				    cur_band = tmp0;
-				        set_band(cur_band, cur_vfo);
-			        }	
-		        }	
-			
-		        if(!strcmp(buf2, "SIDEBAND")) //Sideband change - |Example: "SET SIDEBAND 0"
-		        {
-			        get_info_from_string(buf1, buf3, 2); 
-			        tmp0 = asc2long(buf3);
-			        if((tmp0 >= 0) && (tmp0 <= 1))
-			        {
-    				    sideband = tmp0;
-				        set_frequency2(f_lo[sideband]);
-				        show_sideband(sideband, bcolor);
-			        }	
-		        }
-		    
-		        if(!strcmp(buf2, "VFO")) //VFO - |Example: "SET VFO 0"
-		        {
-    			    get_info_from_string(buf1, buf3, 2); 
-	    		    tmp0 = asc2long(buf3);
-		    	    if((tmp0 >= 0) && (tmp0 <= 1))
-			        {
-				        alt_vfo = cur_vfo;
-					    set_vfo(tmp0);
-					    cur_vfo = tmp0;
-			        }	
-		        }
-		    
-    		    if(!strcmp(buf2, "ATT")) //RX Attenuator - |Example: "SET ATT 0"
-	    	    {
-		    	    get_info_from_string(buf1, buf3, 2); 
-			        tmp0 = asc2long(buf3);
-			        if((tmp0 >= 0) && (tmp0 <= 1))
-			        {
-    				    cur_att = tmp0;
-	    				show_att(cur_att, bcolor);
-		    			set_att(cur_att);
-			        }	
-		        }
+  ////////////////////////////////////
+ //  WATCHDOG AND WARM RESTART     //
+////////////////////////////////////
+//Power-up delay, only a short pulse on warm restart (supply, LCD and DDS are already settled)
+void init_delay(int ms)
+{
+	if(warm_ok)
+	{
+		_delay_us(100);
+		return;
+	}
+	
+	while(ms--)
+	{
+		_delay_ms(1);
+	}
+}	
 
-		        if(!strcmp(buf2, "TONE")) //TONE - |Example: "SET TONE 0" "..3"
-		        {
-			        get_info_from_string(buf1, buf3, 2); 
-			        tmp0 = asc2long(buf3);
-			        if((tmp0 >= 0) && (tmp0 <= 3))
-			        {
-			    	    cur_tone = tmp0;
-					    show_tone(cur_tone, bcolor);
-					    set_tone(cur_tone);
-			        }	
-		        }
-		    
-  		        if(!strcmp(buf2, "AGCS")) //AGC - |Example: "SET AGC 0" "...3"
-		        {
-			        get_info_from_string(buf1, buf3, 2); 
-			        tmp0 = asc2long(buf3);
-			        if((tmp0 >= 0) && (tmp0 <= 3))
-			        {
-			    	    cur_agc = tmp0;
-					    show_agc(cur_agc, bcolor);
-					    set_agc(cur_agc);
-			        }	
-		        }
+//Checksum of warm state (rotate and add)
+unsigned int warm_sum(void)
+{
+	unsigned char *p = (unsigned char*) &warm;
+	unsigned int t1, s = WARM_MAGIC;
+	
+	for(t1 = 0; t1 < sizeof(warm) - sizeof(warm.sum); t1++)
+	{
+		s = ((s << 1) | (s >> 15)) + p[t1];
+	}
+	return s;
+}	
 
-  		        if(!strcmp(buf2, "FREQ")) //QRG in respective band - |Example: "SET FREQ 14210000" "...3"
-		        {
-			        get_info_from_string(buf1, buf3, 2); 
-			        freq_temp0 = asc2long(buf3);
-			        if(is_mem_freq_ok(freq_temp0, cur_band))
-			        {
-                        f_vfo[cur_vfo] = freq_temp0;  
-		                set_frequency1(f_vfo[cur_vfo]);
-		    	        show_frequency1(f_vfo[cur_vfo], 0, bcolor);			    
-		    	    }	
-		    	    else
-		    	    {
-					    show_msg("Freq!", RED);
-					    lcd_putnumber(calcx(8), calcy(14), freq_temp0, -1, 1, LIGHT_RED, bcolor);
-					    _delay_ms(500);
-				    }	
-		        }
-		        		        
-		        if(!strcmp(buf2, "MEM")) //Set ONE memory Syntax: SET MEM [band] [memory] {frequency] |Example: SET MEM 3 1 14325000"
-		        {
-					get_info_from_string(buf1, buf3, 2); //band
-					tmp0 = asc2long(buf3);
-					get_info_from_string(buf1, buf3, 3); //mem number
-					tmp1 = asc2long(buf3);
-					
-					get_info_from_string(buf1, buf4, 4); //frequency
-					freq_temp0 = asc2long(buf4);
-					store_frequency1(freq_temp0, tmp0 * 64 + tmp1 * 4);
-					show_msg("Freq stored: ", bcolor);
-					//lcd_putstring(calcx(0), calcy(12), buf4, 1, YELLOW, bcolor);
-					lcd_putnumber(calcx(12), calcy(14), freq_temp0, -1, 1, YELLOW, bcolor);
-			    }
-			    			    
-			    if(!strcmp(buf2, "LOSC")) //Setting LO freq "SET LO [sideband] [freq] |Example: "SET LO 0 8998500"
-		        {
-					get_info_from_string(buf1, buf3, 2); //LO 0 or 1 (LSB/USB)
-					tmp0 = asc2long(buf3);
-					get_info_from_string(buf1, buf4, 3);
-					freq_temp0 = asc2long(buf4);
-					store_frequency1(freq_temp0, 512 + tmp0 * 4);
-					f_lo[tmp0] = freq_temp0;
-                    set_frequency2(freq_temp0);					
-					lcd_putnumber(calcx(13), calcy(14), tmp0, -1, 1, YELLOW, bcolor);
-					lcd_putnumber(calcx(15), calcy(14), freq_temp0, -1, 1, YELLOW, bcolor);
-					show_msg("LO data set:.", bcolor);
-				}
-				 	
-				if(!strcmp(buf2, "EEPROM")) //Set EEPROM byte "SET EEPROM [byte] [value]]: |Example: "SET EEPROM 127 65"
-		        {
-					get_info_from_string(buf1, buf3, 2); //EEPROM cell
-					tmp0 = asc2long(buf3);
-					get_info_from_string(buf1, buf4, 3); //Value to be set
-					tmp1 = asc2long(buf4);
-					eeprom_write_byte((uint8_t*)tmp0, tmp1);
-					show_msg("OK. (EEPROM)", bcolor); 
-			    }
-			    
-			    if(!strcmp(buf2, "PTT")) //Switch TX on/off |Example: SET PTT 1
-			    {
-		    	    get_info_from_string(buf1, buf3, 2); 
-			        tmp0 = asc2long(buf3);
-			        if(tmp0 == 1)
-			        {
-    				     PORTA |= (1 << 3); //TX on
-			        }	
-			        else
-			        {
-    				     PORTA &= ~(1 << 3); //TX off
-			        }	
-		        }
-		    }
-		    
-		    if(!strcmp(buf2, "GET"))
-            {
-				get_info_from_string(buf1, buf2, 1); 
-				
-				if(!strcmp(buf2, "BAND")) //Return current band |Example: "GET BAND"
-		        {
-					int2asc(cur_band, -1, buf3, MAXRXBUFLEN);
-					usart_sendstring(buf3);
-					usart_send_crlf();
-					show_msg("BAND.", bcolor);
-				}
-						    
-				if(!strcmp(buf2, "VFO")) //Return current band |Example: "GET BAND"
-		        {
-					int2asc(cur_vfo, -1, buf3, MAXRXBUFLEN);
-					usart_sendstring(buf3);
-					usart_send_crlf();
-					show_msg("VFO.", bcolor);
-				}
+//Snapshot of current radio state
+void warm_save(void)
+{
+	warm.magic = WARM_MAGIC;
+	warm.band = cur_band;
+	warm.vfo = cur_vfo;
+	warm.sideband = sideband;
+	warm.split = split;
+	warm.memplace = last_memplace;
+	memcpy(warm.vfo_s, vfo_s, sizeof(vfo_s));
+	memcpy(warm.f_vfo, f_vfo, sizeof(f_vfo));
+	memcpy(warm.f_lo, f_lo, sizeof(f_lo));
+	warm.tone = cur_tone;
+	warm.agc = cur_agc;
+	warm.att = cur_att;
+	warm.blight = blight;
+	warm.s_threshold = s_threshold;
+	memcpy(warm.scanfreq, scanfreq, sizeof(scanfreq));
+	memcpy(warm.tx_preset, tx_preset, sizeof(tx_preset));
+	warm.sum = warm_sum();
+}	
 
-				
-				if(!strcmp(buf2, "FREQ")) //Return current main frequency |Example:"GET FREQ"
-		        {
-					freq_temp0 = f_vfo[cur_vfo];
-					int2asc(freq_temp0, -1, buf3, 12);
-					usart_sendstring(buf3);
-					usart_send_crlf();
-					show_msg("FREQ.", bcolor);
-				}
-				
-				if(!strcmp(buf2, "SIDEBAND")) //Return current band |Example: "GET BAND"
-		        {
-					int2asc(sideband, -1, buf3, MAXRXBUFLEN);
-					usart_sendstring(buf3);
-					usart_send_crlf();
-					show_msg("SIDEBAND.", bcolor);
-				}
-			
-				
-		        if(!strcmp(buf2, "VDD")) //Return voltage value |Example: "GET VDD"
-		        {
-					v1 = (double) get_adc(3) * 5 / 1024 * 5 * 10;
-					tmp0 = (int) v1;
-					int2asc(tmp0, -1, buf3, 12);
-					usart_sendstring(buf3);
-					usart_send_crlf();
-					show_msg("VDD.", bcolor);
-				}
-				
-   	            if(!strcmp(buf2, "TEMP")) //Return temperature value |Example:"GET TEMP"
-		        {
-					v1 = (double) (10.0 * ((2000.0 / (1024.0 / get_adc(2) - 1)) - 1630) / 17.62); 
-					tmp0 = (int) v1;
-					int2asc(tmp0, -1, buf3, 12);
-					usart_sendstring(buf3);
-					usart_send_crlf();
-					show_msg("TEMP.", bcolor);
-				}
-			
-				if(!strcmp(buf2, "MEMALL")) //Return all memroies of all 6 bands |Example: "GET MEMALL"
-		        {
-					show_msg("Transmitting...", bcolor);
-					for(t1 = 0; t1 < 96; t1++)
-					{
-						freq_temp0 = load_frequency1(t1 * 4);
-					    int2asc(freq_temp0, -1, buf3, 12);
-					    usart_sendstring(buf3);
-					    usart_send_crlf();
-					}   
-					show_msg("MEMALL.", bcolor);
-				}
-								
-				if(!strcmp(buf2, "MEM")) //Return ONE memory "GET MEM [band] [memory]: |Example: "GET MEM 1 5"
-		        {
-					get_info_from_string(buf1, buf3, 2); //band
-					tmp0 = asc2long(buf3);
-					get_info_from_string(buf1, buf3, 3); //mem number
-					tmp1 = asc2long(buf3);
-					
-					freq_temp0 = load_frequency1(tmp0 * 64 + tmp1 * 4);
-					int2asc(freq_temp0, -1, buf4, 12);
-					usart_sendstring(buf4);
-					usart_send_crlf();
-					show_msg("MEM.", bcolor);
+void warm_timer(void)
+{
+	warm_save();
+}	
+
+//Take over radio state from before the watchdog reset, returns 0 if there is none
+int warm_resume(void)
+{
+	if(!(reset_cause & (1 << WDRF)) || warm.magic != WARM_MAGIC || warm.sum != warm_sum()
+	   || warm.band < 0 || warm.band > 5 || warm.vfo < 0 || warm.vfo > 1 || warm.sideband < 0 || warm.sideband > 1)
+	{
+		warm.resets = 0;
+		return 0;
+	}
+	
+	cur_band = warm.band;
+	cur_vfo = warm.vfo;
+	alt_vfo = cur_vfo ^ 1;
+	sideband = warm.sideband;
+	split = warm.split;
+	last_memplace = warm.memplace;
+	memcpy(vfo_s, warm.vfo_s, sizeof(vfo_s));
+	memcpy(f_vfo, warm.f_vfo, sizeof(f_vfo));
+	memcpy(f_lo, warm.f_lo, sizeof(f_lo));
+	cur_tone = warm.tone;
+	cur_agc = warm.agc;
+	cur_att = warm.att;
+	blight = warm.blight;
+	s_threshold = warm.s_threshold;
+	memcpy(scanfreq, warm.scanfreq, sizeof(scanfreq));
+	memcpy(tx_preset, warm.tx_preset, sizeof(tx_preset));
+	warm.resets++;
+	
+	//Hardware as set before reset (port bits directly, set_tone() etc. would write EEPROM)
+	PORTA &= ~(0x07);
+	PORTA |= cur_band + 1;
+	PORTG &= ~(0x1B);
+	PORTG |= (cur_tone << 3) | cur_agc;
+	if(cur_att)
+	{
+	    PORTB |= (1 << PB3);
+	}
+	else
+	{
+	    PORTB &= ~(1 << PB3);
+	}
+	set_frequency1(f_vfo[cur_vfo]);
+	set_frequency2(f_lo[sideband]);
+	mcp4725_set_value(tx_preset[cur_band]);
+	
+	show_mem_freq(is_mem_freq_ok(load_frequency0(last_memplace), cur_band) ? load_frequency0(last_memplace) : 0, bcolor);
+	show_all_data(f_vfo[cur_vfo], f_vfo[alt_vfo], 0, sideband, 0, cur_vfo, split, 0, 0, 0, last_memplace, txrx);
+	lcd_setbacklight(blight);
+	lcd_putnumber(calcx(0), calcy(14), f_lo[sideband], -1, 1, WHITE, bcolor);
+	show_msg_P(PSTR("Warm restart."), bcolor);
+	
+	return 1;
+}	
+
+//Load start values from EEPROM and set up radio (cold start)
+void load_start_values(void)
+{
+	int t1;
+	long freq_temp0;
+	
+	//Load last band used
+	cur_band = load_last_band();
+	if(cur_band == -1)
+	{
+		cur_band = 2; //Set 40m as default
+	}
+	    
+	sideband = std_sideband[cur_band];
+		
+	//Load VFO data and VFO number
+    cur_vfo = load_last_vfo();
+    if(cur_vfo < 0 || cur_vfo > 1)
+    {
+		cur_vfo = 0;
+		alt_vfo = 1;
+	}
+	
+	set_band(cur_band, cur_vfo);
+	
+	if(cur_vfo)
+	{
+		alt_vfo = 0;
+	}
+	else
+	{
+		alt_vfo = 1;
+	}	
+	    
+	//Load valid frequency if possible int0 2 VFOs
+	for(t1 = 0; t1 < 2; t1++)
+	{   
+	    freq_temp0 = load_frequency0(cur_band + 96 + t1); 
+        //Check if freq is OK
+        if(is_mem_freq_ok(freq_temp0, cur_band))
+        {
+	         f_vfo[t1] = freq_temp0;
+	    }
+	    else
+	    {
+	        f_vfo[t1] = c_freq[cur_band];
+	    }
+	}    
+	    
+    //Load last stored freqeuncy
+    //Check if memory place is not a random number anywhere in EEPROM
+    last_memplace = load_last_mem();
+    if(last_memplace < 0 || last_memplace > 15)
+    {
+		last_memplace = 0;
+	}
+	
+	//Load LO frequencies if available
+    for(t1 = 0; t1 < 2; t1++)
+    {
+		f_lo[t1] = load_frequency1(512 + t1 * 4);
+		if((f_lo[t1] < F_LO_LSB - 4000) || (f_lo[t1] > F_LO_USB + 4000))
+		{
+			if(!t1)
+			{
+			    f_lo[t1] = F_LO_LSB;
+			}   
+			else
+			{
+			    f_lo[t1] = F_LO_USB;
+			}   
+		}
+	}		
+			
+    for(t1 = 0; t1 < 5; t1++)
+    {
+		set_frequency1(f_vfo[cur_vfo]);
+		set_frequency2(f_lo[sideband]);
+        init_delay(10);
+    }
+
+	
+	//Load scan threshold
+    s_threshold = eeprom_read_byte((uint8_t*)129);          	
+    if(s_threshold > SMAX) //Erased cell or outside of bar scale (0..SMAX)
+    {
+		s_threshold = 100;
+	}
+	
+	//Load scan edge frequencies
+	scanfreq[0] = load_frequency0(108);
+	if(!is_mem_freq_ok(scanfreq[0], cur_band))
+	{
+		scanfreq[0] = band_f0[cur_band];
+		scanfreq[1] = band_f1[cur_band];
+	}	
+	
+	//Split default setting TXA RXB
+	vfo_s[0] = 0;
+	vfo_s[1] = 1;
+    
+    if(is_mem_freq_ok(load_frequency0(last_memplace), cur_band))
+	{
+		show_mem_freq(load_frequency0(last_memplace), bcolor);
+	}
+	else
+	{	
+		show_mem_freq(0, bcolor);	
+	}	
+          
+	//Load sets
+	// 480: TONE set
+    // 481: AGC set
+	cur_tone = eeprom_read_byte((uint8_t*)480);
+	if(cur_tone < 0 ||cur_tone > 3)
+	{
+		cur_tone = 1;
+	}	
+	show_tone(cur_tone, bcolor);
+	set_tone(cur_tone);
+	
+	cur_agc = eeprom_read_byte((uint8_t*)481);
+	if(cur_agc < 0 || cur_agc > 3)
+	{
+		cur_agc = 2;
+	}
+	show_agc(cur_agc, bcolor);
+	set_agc(cur_agc);
+	
+	cur_att = eeprom_read_byte((uint8_t*)483);
+    if(cur_att < 0 || cur_att > 1)
+    {
+		cur_att = 0;
+	}	
+    set_att(cur_att);
+    
+    show_all_data(f_vfo[cur_vfo], f_vfo[alt_vfo], 0, sideband, 0, cur_vfo, 0, 0, 0, 0, last_memplace, txrx);
+    
+	/////////////////////////////////////////////
+	
+	//baCKLIGHT
+    blight = eeprom_read_byte((uint8_t*)482);
+    if(blight < 0 || blight > 255)
+    {
+		blight = 128;
+	}	
+    lcd_setbacklight(blight);
+    
+    lcd_putnumber(calcx(0), calcy(14), f_lo[sideband], -1, 1, WHITE, bcolor);
+            
+    //Load TX preset values
+    for(t1 = 0; t1 < 6; t1++)
+    {
+		tx_preset[t1] = load_tx_preset(t1);
+	}	
+	//Load TX preset
+	mcp4725_set_value(load_tx_preset(cur_band)); 
+}	
+
+  /////////////
+ //  TASKS  //
+/////////////
+//PTT: Switch TX relay and frequencies
+void ptt_task(void)
+{
+	if(get_ptt())
+	{
+		if(!txrx)
+	    {
+		    txrx = 1;
+		    show_txrx(txrx);
+            draw_meter_scale(1, bcolor);				
+	    
+		    switch(split)
+    	    {
+	    		case 1: set_frequency1(f_vfo[vfo_s[0]]);
+		    	        show_frequency1(f_vfo[vfo_s[0]], 0, bcolor);
+                        show_frequency2(8, 9, f_vfo[vfo_s[1]], bcolor, 100, 1); 
+			            break;
+			    case 2: set_frequency1(f_vfo[vfo_s[1]]);
+			            show_frequency1(f_vfo[vfo_s[1]], 0, bcolor);
+				        show_frequency2(8, 9, f_vfo[vfo_s[0]], bcolor, 100, 1); 
+    			        break;        
+	    		case 0: set_frequency1(f_vfo[cur_vfo]);
+		    	        show_frequency1(f_vfo[cur_vfo], 0, bcolor);        
+		    }        
+		    
+		    PORTA |= (1 << 3); //TX on
+		    trace_put(TR_TX, TR_TX_PTT | 1);
+		}   
+    }
+    else
+    {	
+	    if(txrx)
+	    {
+		    txrx = 0;
+		    show_txrx(txrx);
+		    draw_meter_scale(0, bcolor);
+		    
+		    switch(split)
+	        {
+			    case 1: set_frequency1(f_vfo[vfo_s[1]]);
+			            show_frequency1(f_vfo[vfo_s[1]], 0, bcolor);
+                        show_frequency2(8, 9, f_vfo[vfo_s[0]], bcolor, 100, 1); 
+			            break;
+			    case 2: set_frequency1(f_vfo[vfo_s[0]]);
+			            show_frequency1(f_vfo[vfo_s[0]], 0, bcolor);
+			            show_frequency2(8, 9, f_vfo[vfo_s[1]], bcolor, 100, 1); 
+			            break;        
+			    case 0: set_frequency1(f_vfo[cur_vfo]);
+			            show_frequency1(f_vfo[cur_vfo], 0, bcolor);        
+		    }        
+		    
+		    PORTA &= ~(1 << 3); 		//TX off    
+		    trace_put(TR_TX, TR_TX_PTT);
+	    }
+	}
+}	
+
+//VFO used for RX (tx = 0) or TX (tx = 1), vfo_s[] is read as in ptt_task() for both split modes
+int split_vfo(int tx)
+{
+	switch(split)
+	{
+		case 1: return vfo_s[!tx];
+		case 2: return vfo_s[tx];
+	}
+
+	return cur_vfo;
+}
+
+//Rotary encoder
+void tune_task(void)
+{
+	if(knob_get() >= 1 && !txrx)
+	{    
+	    f_vfo[cur_vfo] = tune_step(f_vfo[cur_vfo], 1);  
+	    set_frequency1(f_vfo[cur_vfo]);
+	    knob_ack(1);
+	    show_frequency1(f_vfo[cur_vfo], 0, bcolor);
+	}
+	
+	if(knob_get() <= -1 && !txrx)  
+	{
+	    f_vfo[cur_vfo] = tune_step(f_vfo[cur_vfo], -1);  
+	    set_frequency1(f_vfo[cur_vfo]);
+	    knob_ack(-1);
+		show_frequency1(f_vfo[cur_vfo], 0, bcolor);
+	}
+}	
+
+//Keys and menus
+//K1 and K3 act on press, K2 on short release, long K2 = quick memory store
+void keys_task(void)
+{
+	int t1, key, kev;
+	long rval = 0;
+	long freq_temp0;
+	
+	kev = key_get_event();
+	key = 0;
+	switch(KEY_EVENT(kev))
+	{
+		case KEY_EV_PRESS:   if(KEY_NUM(kev) == 2)
+		                     {
+								 k2_armed = 1;
+							 }
+							 else
+							 {
+								 key = KEY_NUM(kev);
+							 }
+							 break;
+		case KEY_EV_LONG:    if(KEY_NUM(kev) == 2 && k2_armed)
+		                     {
+								 k2_armed = 0;
+								 store_frequency0(f_vfo[cur_vfo], last_memplace);
+								 show_mem_freq(f_vfo[cur_vfo], bcolor);
+								 show_msg_P(PSTR("Quick store M"), bcolor);
+								 lcd_putnumber(calcx(13), calcy(14), last_memplace, -1, 1, LIGHT_GRAY, bcolor);
+								 timer_restart(tmr_msg, T_MSG);
+							 }
+							 break;
+		case KEY_EV_RELEASE: if(KEY_NUM(kev) == 2 && k2_armed) //Release of a K2 press that closed a menu is ignored
+		                     {
+								 k2_armed = 0;
+								 key = 2;
+							 }
+							 break;
+	}
+	
+	//MENU
+    switch(key)
+	{
+	    case 1:	rval = menu0(f_vfo[cur_vfo], cur_vfo, cur_band);
+	            key = 0;
+		        
+		        //BAND
+		        //////
+		        if(rval >= 0 && rval < 6)
+		        {
+					//last_freq[cur_band] = f_vfo[cur_vfo];
+		            cur_band = rval;
+		            set_band(cur_band, cur_vfo);
+		        }   
+		        
+		        //SIDEBAND
+		        //////////
+		        if(rval == 10 || rval == 11) //LSB or USB
+		        {
+		            sideband = rval - 10;
+		            trace_put(TR_SIDEBAND, sideband);
+		            set_frequency1(f_vfo[cur_vfo]);
+		            set_frequency2(f_lo[sideband]);
+		        }    
+		        
+		        //VFO
+		        /////
+		        if(rval == 20 || rval == 21) //VFO A or VFO B set
+		        {
+					alt_vfo = cur_vfo;
+					cur_vfo = rval - 20;
+					if(!set_vfo(rval - 20))
+					{
+						cur_vfo = alt_vfo;
+					}	
+			    }    
+		        
+		        if(rval == 22)
+		        {
+					f_vfo[0] = f_vfo[1]; //VFO A = VFO B
+			    }
+			    
+			    if(rval == 23)
+		        {
+					f_vfo[1] = f_vfo[0]; //VFO B = VFO A
 			    }
 			    
-			    if(!strcmp(buf2, "AGCV"))  //Return current AGC voltage |Example:"GET AGCV"
+			    //ATT, TONE and AGC
+			    if(rval >= 30 && rval <= 32)
 			    {
-					tmp0 = get_s_value();
-					int2asc(tmp0, -1, buf3, 12);
-					usart_sendstring(buf3);
-					usart_send_crlf();
-					show_msg("AGCV.", bcolor);
+					cur_att = rval - 30;
+					show_att(cur_att, bcolor);
+					set_att(cur_att);
 				}
 				
-				if(!strcmp(buf2, "AGCS")) //Return AGC seetings |Example: "GET AGCS"
-		        {
-					int2asc(cur_agc, -1, buf3, MAXRXBUFLEN);
-					usart_sendstring(buf3);
-					usart_send_crlf();
-					show_msg("AGCS.", bcolor);
+			    if(rval >= 40 && rval <= 44)
+			    {
+					cur_tone = rval - 40;
+					show_tone(cur_tone, bcolor);
+					set_tone(cur_tone);
 				}
 				
-				if(!strcmp(buf2, "TONE")) //Return TONE  seetings |Example: "GET TONE"
-		        {
-					int2asc(cur_tone, -1, buf3, MAXRXBUFLEN);
-					usart_sendstring(buf3);
-					usart_send_crlf();
-					show_msg("TONE.", bcolor);
-				}
-
-				if(!strcmp(buf2, "ATT")) //Return ATT  seetings |Example: "GET ATT"
-		        {
-					int2asc(cur_att, -1, buf3, MAXRXBUFLEN);
-					usart_sendstring(buf3);
-					usart_send_crlf();
-					show_msg("ATT.", bcolor);
+				if(rval >= 50 && rval <= 54)
+			    {
+					cur_agc = rval - 50;
+					show_agc(cur_agc, bcolor);
+					set_agc(cur_agc);
 				}
+					
+			    /////////////////////
+			    //MEMORY, SCAN, SPLIT
+			    /////////////////////
+			    switch(rval)
+			    {
+			        case 60:t1 = save_mem_freq(f_vfo[cur_vfo], last_memplace); //Store
+				            if(t1 > -1)
+				            {
+								store_frequency0(f_vfo[cur_vfo], 16 + cur_vfo);
+								last_memplace = t1;
+								store_last_mem(t1);
+				    		}    
+				    		show_frequency1(f_vfo[cur_vfo], 0, bcolor);
+				            set_frequency1(f_vfo[cur_vfo]);
+				            set_frequency2(f_lo[sideband]);
+				            break;
+				            
+				    case 61:freq_temp1 = recall_mem_freq(0);     //Recall QRG  
+				            if(is_mem_freq_ok(freq_temp1 & 0x0FFFFFFF, cur_band) ) //Separate freq from mem_place
+				            {
+								last_memplace = (freq_temp1 >> 28) & 0x0F;
+							    f_vfo[cur_vfo] = freq_temp1  & 0x0FFFFFFF;
+								set_frequency1(f_vfo[cur_vfo]);
+								show_frequency1(f_vfo[cur_vfo], 1, bcolor);
+								show_mem_freq(f_vfo[cur_vfo], bcolor);
+								freq_temp1 &= 0x0FFFFFFF;
+							}	
+							else
+							{
+							    set_frequency1(f_vfo[cur_vfo]);
+							    show_frequency1(f_vfo[cur_vfo], 1, bcolor);
+							}	
+							break;
 				
-				if(!strcmp(buf2, "LOSC")) //Return LO freq "GET LO [sideband]|Example: "GET LO 0"
-		        {
-					get_info_from_string(buf1, buf3, 2); //LO 0 or 1 (LSB/USB)
-					tmp0 = asc2long(buf3);
-					lcd_putnumber(0, 50, tmp0, -1, 1, YELLOW, bcolor);
-					freq_temp0 = load_frequency1(512 + tmp0 * 4);
-					int2asc(freq_temp0, -1, buf4, 16);
-					usart_sendstring(buf4);
-					usart_send_crlf();
-					show_msg("LOSC.", bcolor);
+			        case 70:t1 = scan(0); //Scan MEMs
+			                if(t1 > 0)
+			                {
+				                freq_temp0 = load_frequency0(t1);
+				                if(is_mem_freq_ok(freq_temp0, cur_band))
+				                {
+								    f_vfo[cur_vfo] = freq_temp0;
+							    }	
+							 }   
+							 set_frequency1(f_vfo[cur_vfo]);
+							 set_frequency2(f_lo[sideband]);
+				            break;
+				    
+				    case 71:freq_temp0 = scan(1); //Scan BAND
+				            if(is_mem_freq_ok(freq_temp0, cur_band))
+				            {
+								f_vfo[cur_vfo] = freq_temp0;
+							}	
+							set_frequency1(f_vfo[cur_vfo]);
+							set_frequency2(f_lo[sideband]);
+							break;
+				                  
+				    case 72:lcd_cls(bcolor); //Set scan frequencies
+				            //Load from EEPROM
+				            for(t1 = 0; t1 < 2; t1++)
+				            {
+				                scanfreq[t1] = load_frequency1(cur_band * 2 + 550 + t1 * 4);
+				                if(!is_mem_freq_ok(scanfreq[t1], cur_band))
+				                {
+									if(!t1)
+									{
+								        scanfreq[t1] = band_f0[cur_band] + 100;
+								    }
+								    else    
+								    {
+								        scanfreq[t1] = band_f1[cur_band] - 100;
+								    }
+							    }	
+							}
+							
+				            scanfreq[0] = set_scan_frequency(0, scanfreq[0]);
+				            scanfreq[1] = set_scan_frequency(1, scanfreq[1]); 
+				            
+				            if(scanfreq[1] < scanfreq[0]) //Change freq order if f0 > f1
+				            {
+								freq_temp0 = scanfreq[1];
+								scanfreq[1] = scanfreq[0];
+								scanfreq[0] = freq_temp0;
+							}
+							
+							//Store in EEPROM
+							for(t1 = 0; t1 < 2; t1++)
+							{
+							    store_frequency1(cur_band * 2 + 550 + t1 * 4, scanfreq[t1]);
+							}
+							
+				            break;
+				                
+				    case 73:set_scan_threshold();            
+				            break;
+				    
+				    //SPLIT mode        
+				    case 80: split = 1;
+				             vfo_s[0] = 0;  //TXA RXB
+				             vfo_s[1] = 1;
+				             break;               
+				             
+				    case 81: split = 2;
+				             vfo_s[0] = 1;  //TXA RXB
+				             vfo_s[1] = 0;
+				             break;               
+				             
+				    case 82: split = 0;
+				             show_split(0, bcolor);
+				             break;   
+				    
+				    case 90: set_lo_freq(0);
+				             break;         
+				             
+				    case 91: set_lo_freq(1);
+				             break;         
+				             
+				    case 100: adjustbacklight();
+				             break;          
+				    
+				    case 101: tx_test();
+				             set_frequency1(f_vfo[cur_vfo]);
+				             show_frequency1(f_vfo[cur_vfo], 1, bcolor);
+				             set_band(cur_band, cur_vfo);
+				             txrx = 0;
+				             break;                   
+				    case 102: tune();         
+				             break;
+				    case 103: tx_preset_adjust();
+				             break;         
+				    case 104: 
+		   	        case 105: mem_transfer();
+				              break;          
 			    }
-			    
-			    if(!strcmp(buf2, "EEPROM")) //Return EEPROM byte "GET EEPROM [byte] [memory]: |Example: "GET EEPROM 127"
+			       
+			    ui_restore();
+		        break;
+		        
+		case 2: store_frequency0(f_vfo[0], cur_band + 96);
+		        store_frequency0(f_vfo[1], cur_band + 97);
+		        store_last_band(cur_band);
+		        store_last_vfo(cur_vfo);
+		        show_msg_P(PSTR("Frequency data saved."), bcolor);
+		        timer_restart(tmr_msg, T_MSG);
+		        if(cat_mode == CAT_NATIVE)
 		        {
-					get_info_from_string(buf1, buf3, 2); //EEPROM cell
-					tmp0 = asc2long(buf3);
-					tmp1 = eeprom_read_byte((uint8_t*)tmp0);
-					int2asc(tmp1, -1, buf4, 12);
-					usart_sendstring(buf4);
-					usart_send_crlf();
-					show_msg("EEPROM.", bcolor);
-			    }
-			}		
-		    
-		    for(t1 = 0; t1 < MAXRXBUFLEN; t1++) //Re-init buffers
-	        {
-	            buf1[t1] = 0;
-	            buf2[t1] = 0;
-	            buf3[t1] = 0;   
-	            buf4[t1] = 0;   
-	        }	
-		}   
+		            usart_sendstring_P(PSTR("DK7IH QRP MINI6 COMM OK."));
+		        }
+		        break;
+		        
+		case 3: rval = menu1(10, f_vfo[cur_vfo], cur_vfo, cur_band);
+                switch(rval)
+			    {
+			        case 100: adjustbacklight();
+				             break;          
+				    
+				    case 101: tx_test();
+				             set_frequency1(f_vfo[cur_vfo]);
+				             show_frequency1(f_vfo[cur_vfo], 1, bcolor);
+				             set_band(cur_band, cur_vfo);
+				             txrx = 0;
+				             break;                   
+				    case 102: tune();         
+				             break;
+				    case 103: tx_preset_adjust();
+				             break;   
+                    case 104: 
+		   	        case 105: mem_transfer();
+				              break;          					             
+		        }
+                ui_restore();
+		        break;      
+	}
+}	
+
+//Split CAT line in place at blanks into cat_tok[], one pass
+//Returns number of tokens, -1 if there are more than CAT_MAXTOK
+int cat_tokenize(char *s)
+{
+	int n = 0;
+
+	while(*s)
+	{
+		if(*s == ' ')
+		{
+			*s++ = 0;
+			continue;
+		}
+
+		if(n == CAT_MAXTOK)
+		{
+			return -1;
+		}
+
+		cat_tok[n++] = s;
+		while(*s && *s != ' ')
+		{
+			s++;
+		}
+	}
+
+	return n;
+}
+
+//Answer "ERR" and show reason
+void cat_error(PGM_P msg)
+{
+	usart_sendstring_P(PSTR("ERR"));
+	cat_eol();
+	show_msg_P(msg, RED);
+}
+
+//End of reply: CR LF, or ';' within a line of several commands (CR LF once at the end of the line)
+void cat_eol(void)
+{
+	if(cat_batch)
+	{
+		usart_transmit(';');
+	}
+	else
+	{
+		usart_send_crlf();
+	}
+}
+
+//Send number followed by ' ' or, if last value of reply, by cat_eol()
+void cat_send_num(long v, int last)
+{
+	char s[12];
+
+	int2asc(v, -1, s, sizeof(s));
+	usart_sendstring(s);
+	if(last)
+	{
+		cat_eol();
+	}
+	else
+	{
+		usart_transmit(' ');
+	}
+}
+
+//SET command refused because a modal screen is open? Menus still take PTT and frequency (CAT_MENU)
+int cat_refused(const struct cat_cmd *cmd)
+{
+	return cat_locked == CAT_LOCK_ALL || (cat_locked && !(pgm_read_byte(&cmd->flags) & CAT_MENU));
+}
+
+//Binary search for name (verb S/G + noun) in cat_cmds[], 0 if unknown
+const struct cat_cmd *cat_find(char *name)
+{
+	int lo = 0, hi = CAT_CMDS - 1, mid, c;
+
+	while(lo <= hi)
+	{
+		mid = (lo + hi) >> 1;
+		c = strcmp_P(name, cat_cmds[mid].name);
+		if(!c)
+		{
+			return &cat_cmds[mid];
+		}
+		if(c < 0)
+		{
+			hi = mid - 1;
+		}
+		else
+		{
+			lo = mid + 1;
+		}
+	}
+
+	return 0;
+}
+
+//Argument n of cmd within lo...hi of table?
+int cat_in_range(const struct cat_cmd *cmd, int n, long v)
+{
+	return v >= (long) pgm_read_dword(&cmd->lo[n]) && v <= (long) pgm_read_dword(&cmd->hi[n]);
+}
+
+//Execute line of one or more commands separated by ';' |Example: "SET BAND 3;SET FREQ 14200000;GET AGCV"
+void cat_line(char *line)
+{
+	char *next;
+
+	if(!strchr(line, ';'))
+	{
+		cat_exec(line);
+		return;
+	}
+
+	cat_batch = 1;
+	cat_quiet = 1;
+	while(line)
+	{
+		next = strchr(line, ';');
+		if(next)
+		{
+			*next++ = 0;
+		}
+		if(*line)
+		{
+			cat_exec(line);
+		}
+		line = next;
+	}
+	cat_batch = 0;
+	cat_quiet = 0;
+	usart_send_crlf();
+}
+
+//Look up "SET|GET NOUN [args]" in cat_cmds[], check arguments and call handler
+void cat_exec(char *line)
+{
+	char name[CAT_NOUNLEN + 3]; //Verb, noun, "." for message
+	long arg[CAT_MAXARG];
+	int n, t1, type;
+	const struct cat_cmd *cmd;
+
+	n = cat_tokenize(line);
+	if(n < 2 || strlen(cat_tok[0]) != 3 || (cat_tok[0][0] != 'S' && cat_tok[0][0] != 'G')
+	   || strcmp_P(cat_tok[0] + 1, PSTR("ET")) || strlen(cat_tok[1]) > CAT_NOUNLEN)
+	{
+		cat_error(PSTR("Command?"));
+		return;
+	}
+
+	name[0] = cat_tok[0][0];
+	strcpy(name + 1, cat_tok[1]);
+
+	cmd = cat_find(name);
+	if(!cmd)
+	{
+		cat_error(PSTR("Command?"));
+		return;
+	}
+
+	if(n != pgm_read_byte(&cmd->args) + 2)
+	{
+		cat_error(PSTR("Syntax!"));
+		return;
+	}
+
+	if(cat_batch && (pgm_read_byte(&cmd->flags) & CAT_LINES)) //Would break the single line reply
+	{
+		cat_error(PSTR("Alone!"));
+		return;
+	}
+
+	for(t1 = 0; t1 < n - 2; t1++)
+	{
+		type = pgm_read_byte(&cmd->type[t1]);
+		if(type == CAT_RESET)
+		{
+			if(strcmp_P(cat_tok[t1 + 2], PSTR("RESET")))
+			{
+				cat_error(PSTR("Syntax!"));
+				return;
+			}
+		}
+		else if(type == CAT_STREAM)
+		{
+			if((arg[t1] = stream_find(cat_tok[t1 + 2])) < 0)
+			{
+				cat_error(PSTR("Syntax!"));
+				return;
+			}
+		}
+		else if(parse_long(cat_tok[t1 + 2], &arg[t1]))
+		{
+			cat_error(PSTR("Syntax!"));
+			return;
+		}
+		else if(!cat_in_range(cmd, t1, arg[t1]))
+		{
+			cat_error(PSTR("Range!"));
+			return;
+		}
+	}
+
+	if(name[0] == 'S' && cat_refused(cmd))
+	{
+		cat_error(PSTR("Busy!"));
+		return;
+	}
+
+	usart_baud_check(1);
+
+	if(!cat_batch) //A line of several commands is only echoed
+	{
+		if(name[0] == 'G') //Default message, handler may overwrite it
+		{
+			strcat_P(name + 1, PSTR("."));
+			show_msg(name + 1, bcolor);
+		}
+		else
+		{
+			show_msg_P(PSTR(""), bcolor);
+		}
+	}
+
+	((void (*)(long*)) pgm_read_word(&cmd->fn))(arg);
+}
+
+  //////////////////
+ //  CAT: SET    //
+//////////////////
+//Band change |Example: "SET BAND 0"
+void cat_set_band(long *a)
+{
+	cur_band = a[0];
+	set_band(cur_band, cur_vfo);
+}
+
+//Sideband change |Example: "SET SIDEBAND 0"
+void cat_set_sideband(long *a)
+{
+	sideband = a[0];
+	trace_put(TR_SIDEBAND, sideband);
+	set_frequency2(f_lo[sideband]);
+	show_sideband(sideband, bcolor);
+}
+
+//VFO |Example: "SET VFO 0"
+void cat_set_vfo(long *a)
+{
+	if(set_vfo(a[0])) //Unchanged if frequency is outside of band
+	{
+		cur_vfo = a[0];
+		alt_vfo = cur_vfo ^ 1;
+	}
+}
+
+//RX Attenuator |Example: "SET ATT 0"
+void cat_set_att(long *a)
+{
+	cur_att = a[0];
+	show_att(cur_att, bcolor);
+	set_att(cur_att);
+}
+
+//TONE |Example: "SET TONE 0" "..3"
+void cat_set_tone(long *a)
+{
+	cur_tone = a[0];
+	show_tone(cur_tone, bcolor);
+	set_tone(cur_tone);
+}
+
+//AGC |Example: "SET AGCS 0" "...3"
+void cat_set_agcs(long *a)
+{
+	cur_agc = a[0];
+	show_agc(cur_agc, bcolor);
+	set_agc(cur_agc);
+}
+
+//QRG in respective band |Example: "SET FREQ 14210000"
+void cat_set_freq(long *a)
+{
+	if(is_mem_freq_ok(a[0], cur_band))
+	{
+		f_vfo[cur_vfo] = a[0];
+		set_frequency1(f_vfo[cur_vfo]);
+		show_frequency1(f_vfo[cur_vfo], 0, bcolor);
+	}
+	else
+	{
+		show_msg_P(PSTR("Freq!"), RED);
+		lcd_putnumber(calcx(8), calcy(14), a[0], -1, 1, LIGHT_RED, bcolor);
+	}
+}
+
+//Set ONE memory: SET MEM [band] [memory] [frequency] |Example: "SET MEM 3 1 14325000"
+void cat_set_mem(long *a)
+{
+	store_frequency1(a[2], a[0] * 64 + a[1] * 4);
+	show_msg_P(PSTR("Freq stored: "), bcolor);
+	lcd_putnumber(calcx(12), calcy(14), a[2], -1, 1, YELLOW, bcolor);
+}
+
+//Setting LO freq: SET LOSC [sideband] [freq] |Example: "SET LOSC 0 8998500"
+void cat_set_losc(long *a)
+{
+	store_frequency1(a[1], 512 + a[0] * 4);
+	f_lo[a[0]] = a[1];
+	set_frequency2(a[1]);
+	lcd_putnumber(calcx(13), calcy(14), a[0], -1, 1, YELLOW, bcolor);
+	lcd_putnumber(calcx(15), calcy(14), a[1], -1, 1, YELLOW, bcolor);
+	show_msg_P(PSTR("LO data set:."), bcolor);
+}
+
+//Set EEPROM byte: SET EEPROM [byte] [value] |Example: "SET EEPROM 127 65"
+void cat_set_eeprom(long *a)
+{
+	eeprom_store(a[0], a[1]);
+	TRACE_EEPROM(a[0], a[1]);
+	show_msg_P(PSTR("OK. (EEPROM)"), bcolor);
+}
+
+//S-Meter calibration offset in dB: SET SMCAL [band] [offset] |Example: "SET SMCAL 3 -4"
+void cat_set_smcal(long *a)
+{
+	smeter_store_cal(a[0], a[1]);
+	show_msg_P(PSTR("OK. (SMCAL)"), bcolor);
+}
+
+#if PROF_ENABLE
+//Clear profiler |Example: "SET PROF RESET"
+void cat_set_prof(long *a)
+{
+	prof_reset();
+	show_msg_P(PSTR("OK. (PROF)"), bcolor);
+}
+#endif
+
+//Clear scheduler statistics and sleep time |Example: "SET SCHED RESET"
+void cat_set_sched(long *a)
+{
+	sched_reset();
+	sleep_ms = 0;
+	sleep_since = get_ms();
+	show_msg_P(PSTR("OK. (SCHED)"), bcolor);
+}
+
+//CAT baud rate 2400...115200, confirm by any command at new rate within 5s |Example: "SET BAUD 38400"
+void cat_set_baud(long *a)
+{
+	int t1;
+
+	for(t1 = 0; t1 < BAUD_RATES && pgm_read_dword(&baud_rate[t1]) != a[0]; t1++);
+	if(t1 < BAUD_RATES)
+	{
+		usart_sendstring_P(PSTR("SET BAUD "));
+		cat_send_num(a[0], 1);
+		usart_set_baud(t1);
+		show_msg_P(PSTR("OK. (BAUD)"), bcolor);
+	}
+	else
+	{
+		cat_error(PSTR("Baud rate!"));
+	}
+}
+
+//CAT personality 0 = native, 1 = + Kenwood TS-480 |Example: "SET CATMODE 1"
+void cat_set_catmode(long *a)
+{
+	cat_mode = a[0];
+	eeprom_store(CAT_MODE_ADR, cat_mode);
+	TRACE_EEPROM(CAT_MODE_ADR, cat_mode);
+	show_msg_P(PSTR("OK. (CATMODE)"), bcolor);
+}
+
+//Push value on change, max. updates/s (0 = off) |Example: "SET STREAM SMETER 10"
+void cat_set_stream(long *a)
+{
+	stream_rate[a[0]] = a[1];
+	if(a[1])
+	{
+		stream_ms[a[0]] = 1000 / a[1];
+		stream_t[a[0]] = get_ms() - stream_ms[a[0]];
+		stream_v[a[0]] = -2147483647L - 1; //Send current value at once
+	}
+	show_msg_P(PSTR("OK. (STREAM)"), bcolor);
+}
+
+//Switch TX on/off |Example: "SET PTT 1"
+void cat_set_ptt(long *a)
+{
+	if(a[0])
+	{
+		PORTA |= (1 << 3); //TX on
+		trace_put(TR_TX, TR_TX_CAT | 1);
+	}
+	else
+	{
+		PORTA &= ~(1 << 3); //TX off
+		trace_put(TR_TX, TR_TX_CAT);
+	}
+}
+
+  //////////////////
+ //  CAT: GET    //
+//////////////////
+//Return status record: FREQ BAND VFO SIDEBAND ATT TONE AGCS VDD TEMP AGCV |Example: "GET ALL"
+void cat_get_all(long *a)
+{
+	cat_send_num(f_vfo[cur_vfo], 0);
+	cat_send_num(cur_band, 0);
+	cat_send_num(cur_vfo, 0);
+	cat_send_num(sideband, 0);
+	cat_send_num(cur_att, 0);
+	cat_send_num(cur_tone, 0);
+	cat_send_num(cur_agc, 0);
+	cat_send_num(get_volts10(), 0);
+	cat_send_num(get_temp10(), 0);
+	cat_send_num(get_s_dbm(), 1);
+}
+
+//Return current band |Example: "GET BAND"
+void cat_get_band(long *a)
+{
+	cat_send_num(cur_band, 1);
+}
+
+//Return current VFO |Example: "GET VFO"
+void cat_get_vfo(long *a)
+{
+	cat_send_num(cur_vfo, 1);
+}
+
+//Return current main frequency |Example: "GET FREQ"
+void cat_get_freq(long *a)
+{
+	cat_send_num(f_vfo[cur_vfo], 1);
+}
+
+//Return current sideband |Example: "GET SIDEBAND"
+void cat_get_sideband(long *a)
+{
+	cat_send_num(sideband, 1);
+}
+
+//Return voltage value |Example: "GET VDD"
+void cat_get_vdd(long *a)
+{
+	cat_send_num(get_volts10(), 1);
+}
+
+//Return temperature value |Example: "GET TEMP"
+void cat_get_temp(long *a)
+{
+	cat_send_num(get_temp10(), 1);
+}
+
+//Return all memories of all 6 bands |Example: "GET MEMALL"
+void cat_get_memall(long *a)
+{
+	show_msg_P(PSTR("Transmitting..."), bcolor);
+	memall_pos = 0; //Sent line by line by cat_task()
+}
+
+//Return ONE memory: GET MEM [band] [memory] |Example: "GET MEM 1 5"
+void cat_get_mem(long *a)
+{
+	cat_send_num(load_frequency1(a[0] * 64 + a[1] * 4), 1);
+}
+
+//Return current signal level in dBm |Example: "GET AGCV"
+void cat_get_agcv(long *a)
+{
+	cat_send_num(get_s_dbm(), 1);
+}
+
+//Return S-Meter calibration: GET SMCAL [band] |Example: "GET SMCAL 3"
+void cat_get_smcal(long *a)
+{
+	cat_send_num(smeter_cal[a[0]], 1);
+}
+
+//Return AGC settings |Example: "GET AGCS"
+void cat_get_agcs(long *a)
+{
+	cat_send_num(cur_agc, 1);
+}
+
+//Return TONE settings |Example: "GET TONE"
+void cat_get_tone(long *a)
+{
+	cat_send_num(cur_tone, 1);
+}
+
+//Return ATT settings |Example: "GET ATT"
+void cat_get_att(long *a)
+{
+	cat_send_num(cur_att, 1);
+}
+
+//Return LO freq: GET LOSC [sideband] |Example: "GET LOSC 0"
+void cat_get_losc(long *a)
+{
+	cat_send_num(load_frequency1(512 + a[0] * 4), 1);
+}
+
+#if PROF_ENABLE
+//Return profiler data, one line per section |Example: "GET PROF"
+void cat_get_prof(long *a)
+{
+	prof_report();
+}
+#endif
+
+//Return ms asleep, ms total and sleep percentage since boot or SET SCHED RESET |Example: "GET SLEEP"
+void cat_get_sleep(long *a)
+{
+	long t = get_ms() - sleep_since;
+
+	cat_send_num(sleep_ms, 0);
+	cat_send_num(t, 0);
+	cat_send_num((t > 0) ? sleep_ms / (t / 100 + 1) : t, 1);
+}
+
+//Return min. free stack observed (bytes) |Example: "GET STACK"
+void cat_get_stack(long *a)
+{
+	cat_send_num(stack_free(), 1);
+}
+
+//Return reset cause (MCUCSR hex), warm restarts, TWI and EEPROM timeouts |Example: "GET RESET"
+void cat_get_reset(long *a)
+{
+	usart_sendhex(reset_cause, 2);
+	usart_transmit(' ');
+	cat_send_num(warm.resets, 0);
+	cat_send_num(twi_errors, 0);
+	cat_send_num(eeprom_timeouts, 1);
+}
+
+//Return CAT baud rate |Example: "GET BAUD"
+void cat_get_baud(long *a)
+{
+	cat_send_num(pgm_read_dword(&baud_rate[baud_idx]), 1);
+}
+
+//Return CAT personality |Example: "GET CATMODE"
+void cat_get_catmode(long *a)
+{
+	cat_send_num(cat_mode, 1);
+}
+
+//Return updates/s of all streams: FREQ BAND VFO SIDEBAND PTT SMETER |Example: "GET STREAM"
+void cat_get_stream(long *a)
+{
+	int t1;
+
+	for(t1 = 0; t1 < STREAMS; t1++)
+	{
+		cat_send_num(stream_rate[t1], t1 == STREAMS - 1);
+	}
+}
+
+//Return receiver overruns, RX and TX buffer overflows, binary frames with CRC error |Example: "GET UART"
+void cat_get_uart(long *a)
+{
+	long overruns, rx_lost;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		overruns = uart_overruns;
+		rx_lost = uart_rx_lost;
+	}
+	cat_send_num(overruns, 0);
+	cat_send_num(rx_lost, 0);
+	cat_send_num(uart_tx_lost, 0);
+	cat_send_num(catb_crc_errors, 1);
+}
+
+//Return scratch memory high-water mark, size, overflows, spill buffer high-water mark and failed requests |Example: "GET SCRATCH"
+void cat_get_scratch(long *a)
+{
+	cat_send_num(scratch_hwm, 0);
+	cat_send_num(SCRATCH_SIZE, 0);
+	cat_send_num(scratch_overflow, 0);
+	cat_send_num(scratch_spill_hwm, 0);
+	cat_send_num(scratch_fail, 1);
+}
+
+//Return event trace, oldest first |Example: "GET TRACE"
+void cat_get_trace(long *a)
+{
+	trace_dump();
+}
+
+//Return task statistics, one line per task |Example: "GET SCHED"
+void cat_get_sched(long *a)
+{
+	sched_report();
+}
+
+//Return EEPROM byte: GET EEPROM [byte] |Example: "GET EEPROM 127"
+void cat_get_eeprom(long *a)
+{
+	cat_send_num(eeprom_read_byte((uint8_t*)(int) a[0]), 1);
+}
+
+  //////////////////////////////
+ //  CAT: BINARY FRAMES      //
+//////////////////////////////
+//Current value of binary CAT item
+long catb_value(int item)
+{
+	switch(item)
+	{
+		case CATB_FREQ:     return f_vfo[cur_vfo];
+		case CATB_SIDEBAND: return sideband;
+		case CATB_VFO:      return cur_vfo;
+		case CATB_ATT:      return cur_att;
+		case CATB_SMETER:   return get_s_dbm();
+		case CATB_BAND:     return cur_band;
+		case CATB_TONE:     return cur_tone;
+		case CATB_AGC:      return cur_agc;
+	}
+
+	return 0;
+}
+
+//Set item through the handler of its text command, returns CATB_OK, CATB_RANGE or CATB_REJECT
+int catb_set(int item, long v)
+{
+	char name[CAT_NOUNLEN + 2];
+	const struct cat_cmd *cmd;
+
+	strcpy_P(name, catb_items[item].name);
+	cmd = cat_find(name);
+	if(!cat_in_range(cmd, 0, v))
+	{
+		return CATB_RANGE;
+	}
+
+	if(cat_refused(cmd))
+	{
+		return CATB_REJECT;
+	}
+
+	((void (*)(long*)) pgm_read_word(&cmd->fn))(&v);
+
+	return (catb_value(item) == v) ? CATB_OK : CATB_REJECT;
+}
+
+//Send byte of reply frame, CRC is built on the fly
+void catb_send(unsigned char b)
+{
+	catb_txcrc = _crc_xmodem_update(catb_txcrc, b);
+	usart_transmit(b);
+}
+
+//Send value with n bytes, MSB first
+void catb_send_value(long v, int n)
+{
+	while(n--)
+	{
+		catb_send(v >> (n * 8));
+	}
+}
+
+//Start reply frame with payload length len and sequence number seq
+void catb_begin(int len, unsigned char seq)
+{
+	usart_transmit(CATB_SYNC);
+	catb_txcrc = 0xFFFF;
+	catb_send(len);
+	catb_send(seq);
+}
+
+void catb_end(void)
+{
+	unsigned int crc = catb_txcrc;
+
+	usart_transmit(crc >> 8);
+	usart_transmit(crc & 0xFF);
+}
+
+//Execute complete frame in catb_buf[] (LEN SEQ OPS CRC) and answer all ops in one reply frame
+void catb_exec(void)
+{
+	int t1, len = catb_buf[0], rlen = 0;
+	int item, size;
+	unsigned int crc = 0xFFFF;
+	unsigned char *p, *end = catb_buf + 2 + len;
+	long v;
+
+	for(t1 = 0; t1 < len + 2; t1++)
+	{
+		crc = _crc_xmodem_update(crc, catb_buf[t1]);
+	}
+
+	if(crc != (((unsigned int) catb_buf[len + 2] << 8) | catb_buf[len + 3]))
+	{
+		catb_crc_errors++;
+		catb_begin(2, catb_buf[1]);
+		catb_send(CATB_NAK);
+		catb_send(CATB_NAK_CRC);
+		catb_end();
+		return;
+	}
+
+	usart_baud_check(1);
+
+	if(len && (catb_buf[2] == CATB_EE_READ || catb_buf[2] == CATB_EE_WRITE))
+	{
+		catb_eeprom();
+		return;
+	}
+
+	//Pass 1: Check ops and get reply length, so the reply can be sent without a buffer
+	for(p = catb_buf + 2; p < end; p += (*p & CATB_SET) ? size + 1 : 1)
+	{
+		item = *p & ~CATB_SET;
+		if(item >= CATB_ITEMS || ((*p & CATB_SET) && !pgm_read_byte(&catb_items[item].name[0]))
+		   || ((*p & CATB_SET) && p + pgm_read_byte(&catb_items[item].size) >= end))
+		{
+			catb_begin(2, catb_buf[1]); //Unknown or incomplete op: NAK and offset of op, nothing executed
+			catb_send(CATB_NAK);
+			catb_send(p - catb_buf - 2);
+			catb_end();
+			return;
+		}
+		size = pgm_read_byte(&catb_items[item].size);
+		rlen += size + 2;
+	}
+
+	//Pass 2: Execute, reply op, status and current value for each op
+	catb_begin(rlen, catb_buf[1]);
+	for(p = catb_buf + 2; p < end; p += (*p & CATB_SET) ? size + 1 : 1)
+	{
+		item = *p & ~CATB_SET;
+		size = pgm_read_byte(&catb_items[item].size);
+		catb_send(*p);
+		if(*p & CATB_SET)
+		{
+			for(v = 0, t1 = 1; t1 <= size; t1++)
+			{
+				v = (v << 8) | p[t1];
+			}
+			catb_send(catb_set(item, v));
+		}
+		else
+		{
+			catb_send(CATB_OK);
+		}
+		catb_send_value(catb_value(item), size);
+	}
+	catb_end();
+}
+
+//EEPROM block transfer, one chunk per frame, the frame CRC protects the chunk
+//Read:  0x40 ADR_HI ADR_LO N      -> 0x40 status ADR_HI ADR_LO DATA[N]
+//Write: 0x41 ADR_HI ADR_LO DATA   -> 0x41 status NEXT_HI NEXT_LO changed
+//Status CATB_OK (ACK) or CATB_RANGE (NAK, nothing done). Only bytes that differ are written,
+//so a repeated chunk costs no write cycles and a transfer can be resumed at any acknowledged address.
+void catb_eeprom(void)
+{
+	int len = catb_buf[0], n, t1, changed = 0;
+	unsigned char op = catb_buf[2], d;
+	unsigned int adr = ((unsigned int) catb_buf[3] << 8) | catb_buf[4];
+
+	n = (op == CATB_EE_READ) ? catb_buf[5] : len - 3;
+	if(len < 3 || (op == CATB_EE_READ && len != 4) || n > CATB_EE_CHUNK || (long) adr + n > E2END + 1)
+	{
+		catb_begin(4, catb_buf[1]);
+		catb_send(op);
+		catb_send(CATB_RANGE);
+		catb_send_value(adr, 2);
+		catb_end();
+		return;
+	}
+
+	eeprom_wait();
+	if(op == CATB_EE_READ)
+	{
+		catb_begin(4 + n, catb_buf[1]);
+		catb_send(op);
+		catb_send(CATB_OK);
+		catb_send_value(adr, 2);
+		for(t1 = 0; t1 < n; t1++)
+		{
+			catb_send(eeprom_read_byte((uint8_t*)(adr + t1)));
+		}
+		catb_end();
+	}
+	else if(cat_locked)
+	{
+		catb_begin(5, catb_buf[1]);
+		catb_send(op);
+		catb_send(CATB_REJECT);
+		catb_send_value(adr, 2);
+		catb_send(0);
+		catb_end();
+		return;
+	}
+	else
+	{
+		for(t1 = 0; t1 < n; t1++)
+		{
+			d = catb_buf[5 + t1];
+			if(eeprom_read_byte((uint8_t*)(adr + t1)) != d)
+			{
+				wdt_reset();
+				eeprom_store(adr + t1, d);
+				changed++;
+			}
+		}
+		TRACE_EEPROM(adr, changed);
+
+		catb_begin(5, catb_buf[1]);
+		catb_send(op);
+		catb_send(CATB_OK);
+		catb_send_value(adr + n, 2);
+		catb_send(changed);
+		catb_end();
+	}
+	catb_ee_chunks++;
+}
+
+//Binary frame receiver, ch = received byte or -1
+void catb_rx(int ch)
+{
+	if(ch < 0)
+	{
+		if(get_ms() - catb_t0 > CATB_TIMEOUT)
+		{
+			catb_cnt = -1; //Frame incomplete, back to text mode
+		}
+		return;
+	}
+
+	catb_t0 = get_ms();
+	if(catb_cnt < 0) //SYNC
+	{
+		catb_cnt = 0;
+		return;
+	}
+
+	catb_buf[catb_cnt++] = ch;
+	if(catb_buf[0] > CATB_MAXLEN)
+	{
+		catb_cnt = -1;
+		catb_crc_errors++;
+	}
+	else if(catb_cnt == catb_buf[0] + 4)
+	{
+		PROF_START(PROF_CAT);
+		trace_put(TR_CAT, ((unsigned long) CATB_SYNC << 24) | ((unsigned long) catb_buf[1] << 16) | (catb_buf[0] << 8) | catb_buf[2]);
+		cat_quiet = 1;
+		catb_exec();
+		cat_quiet = 0;
+		catb_cnt = -1;
+		PROF_STOP(PROF_CAT);
+	}
+}
+
+  //////////////////////////////
+ //  CAT: KENWOOD TS-480     //
+//////////////////////////////
+//Write v as n digits with leading zeros, no terminating 0
+void kw_digits(char *p, long v, int n)
+{
+	char s[12];
+	int t1;
+
+	int2asc_fixed(v, -1, s, n);
+	for(t1 = 0; t1 < n; t1++)
+	{
+		p[t1] = (s[t1] == ' ') ? '0' : s[t1];
+	}
+}
+
+//Answer "?;" for unknown commands and parameters
+void kw_error(void)
+{
+	usart_sendstring_P(PSTR("?;"));
+}
+
+//Settings can't be changed while a modal screen is open, answers "?;" then
+//menu = 1: PTT and frequency, also taken while a menu is open
+int kw_locked(int menu)
+{
+	int locked = cat_locked == CAT_LOCK_ALL || (cat_locked && !menu);
+
+	if(locked)
+	{
+		kw_error();
+	}
+
+	return locked;
+}
+
+//Set frequency of VFO, band is changed if necessary (active VFO only)
+void kw_freq(int vfo, char *p)
+{
+	long f;
+	int t1;
+	char s[15];
+
+	if(!*p)
+	{
+		s[0] = 'F';
+		s[1] = 'A' + vfo;
+		kw_digits(s + 2, f_vfo[vfo], 11);
+		s[13] = ';';
+		s[14] = 0;
+		usart_sendstring(s);
+		return;
+	}
+
+	if(parse_long(p, &f))
+	{
+		kw_error();
+		return;
+	}
+
+	if(kw_locked(1))
+	{
+		return;
+	}
+
+	if(!is_mem_freq_ok(f, cur_band))
+	{
+		for(t1 = 0; t1 < 6 && !is_mem_freq_ok(f, t1); t1++);
+		if(t1 == 6 || vfo != cur_vfo || cat_locked) //No band change under a menu
+		{
+			kw_error();
+			return;
+		}
+		cur_band = t1;
+		set_band(cur_band, cur_vfo);
+	}
+
+	f_vfo[vfo] = f;
+	if(vfo == cur_vfo)
+	{
+		set_frequency1(f_vfo[cur_vfo]);
+		show_frequency1(f_vfo[cur_vfo], 0, bcolor);
+	}
+}
+
+//VFO A frequency |Example: "FA00014195000;"
+void kw_fa(char *p)
+{
+	kw_freq(0, p);
+}
+
+//VFO B frequency |Example: "FB00014195000;"
+void kw_fb(char *p)
+{
+	kw_freq(1, p);
+}
+
+//RX VFO, also used for TX (split off) |Example: "FR1;"
+void kw_fr(char *p)
+{
+	long v = 0;
+
+	if(!*p)
+	{
+		usart_sendstring_P(PSTR("FR"));
+		usart_transmit('0' + split_vfo(0));
+		usart_transmit(';');
+	}
+	else if(parse_long(p, &v) || v < 0 || v > 1)
+	{
+		kw_error();
+	}
+	else if(!kw_locked(0))
+	{
+		split = 0;
+		show_split(0, bcolor);
+		if(v != cur_vfo)
+		{
+			cat_set_vfo(&v);
+		}
+	}
+}
+
+//TX VFO, split on if it differs from RX VFO |Example: "FT0;"
+void kw_ft(char *p)
+{
+	long v = 0;
+
+	if(!*p)
+	{
+		usart_sendstring_P(PSTR("FT"));
+		usart_transmit('0' + split_vfo(1));
+		usart_transmit(';');
+	}
+	else if(parse_long(p, &v) || v < 0 || v > 1)
+	{
+		kw_error();
+	}
+	else if(!kw_locked(0))
+	{
+		if(v == cur_vfo)
+		{
+			split = 0;
+		}
+		else
+		{
+			split = 1; //TX on vfo_s[0], RX on vfo_s[1], see ptt_task()
+			vfo_s[0] = v;
+			vfo_s[1] = cur_vfo;
+		}
+		show_split(split != 0, bcolor);
+	}
+}
+
+//Mode: 1 = LSB, 2 = USB |Example: "MD2;"
+void kw_md(char *p)
+{
+	long v = 0;
+
+	if(!*p)
+	{
+		usart_sendstring_P(PSTR("MD"));
+		usart_transmit('1' + sideband);
+		usart_transmit(';');
+	}
+	else if(parse_long(p, &v) || v < 1 || v > 2)
+	{
+		kw_error();
+	}
+	else if(!kw_locked(0))
+	{
+		v--;
+		cat_set_sideband(&v);
+	}
+}
+
+//Transceiver status, 38 chars, rebuilt only if one of its values has changed
+void kw_if(char *p)
+{
+	int tx = (PORTA >> 3) & 1; //TX relay, switched by PTT and CAT
+	int state = tx | (sideband << 1) | (cur_vfo << 2) | ((split != 0) << 3);
+
+	if(kw_if_f != f_vfo[cur_vfo] || kw_if_state != state)
+	{
+		//IF, freq, step, RIT offset, RIT, XIT, bank, mem, TX, mode, VFO, scan, split, tone, tone no., shift
+		strcpy_P(kw_if_buf, PSTR("IF00000000000     +000000000000000000;"));
+		kw_digits(kw_if_buf + 2, f_vfo[cur_vfo], 11);
+		kw_if_buf[28] = '0' + tx;
+		kw_if_buf[29] = '1' + sideband;
+		kw_if_buf[30] = '0' + cur_vfo;
+		kw_if_buf[32] = '0' + (split != 0);
+		kw_if_f = f_vfo[cur_vfo];
+		kw_if_state = state;
+	}
+
+	usart_sendstring(kw_if_buf);
+}
+
+//S-meter 0000...0030 (S9 = 15, S9+60dB = 30), cached for KW_SM_MS |Example: "SM0;"
+void kw_sm(char *p)
+{
+	int dbm, v;
+
+	if(*p && strcmp_P(p, PSTR("0")))
+	{
+		kw_error();
+		return;
+	}
+
+	if(get_ms() - kw_sm_t >= KW_SM_MS || !kw_sm_buf[0])
+	{
+		dbm = get_s_dbm() - SMETER_S9_DBM;
+		if(dbm <= 0)
+		{
+			v = 15 + (dbm * 15) / 54;  //S0...S9: 54dB
+		}
+		else
+		{
+			v = 15 + dbm / 4;          //S9...S9+60dB
+		}
+		if(v < 0)
+		{
+			v = 0;
+		}
+		if(v > 30)
+		{
+			v = 30;
+		}
+		strcpy_P(kw_sm_buf, PSTR("SM00000;"));
+		kw_digits(kw_sm_buf + 3, v, 4);
+		kw_sm_t = get_ms();
+	}
+
+	usart_sendstring(kw_sm_buf);
+}
+
+//PTT on |Example: "TX;"
+void kw_tx(char *p)
+{
+	long v = 1;
+
+	if(!kw_locked(1))
+	{
+		cat_set_ptt(&v);
+	}
+}
+
+//PTT off |Example: "RX;"
+void kw_rx(char *p)
+{
+	long v = 0;
+
+	if(!kw_locked(1))
+	{
+		cat_set_ptt(&v);
+	}
+}
+
+//Auto information, only off (0) is supported |Example: "AI0;"
+void kw_ai(char *p)
+{
+	if(!*p)
+	{
+		usart_sendstring_P(PSTR("AI0;"));
+	}
+	else if(strcmp_P(p, PSTR("0")))
+	{
+		kw_error();
+	}
+}
+
+//Transceiver ID, 020 = TS-480 |Example: "ID;"
+void kw_id(char *p)
+{
+	usart_sendstring_P(PSTR("ID020;"));
+}
+
+//Power status, always on |Example: "PS;"
+void kw_ps(char *p)
+{
+	if(!*p)
+	{
+		usart_sendstring_P(PSTR("PS1;"));
+	}
+}
+
+//Execute Kenwood command (2 letters + parameters, ';' already removed)
+void kw_exec(char *line)
+{
+	int lo = 0, hi = KW_CMDS - 1, mid, c;
+
+	if(strlen(line) < 2)
+	{
+		kw_error();
+		return;
+	}
+
+	while(lo <= hi)
+	{
+		mid = (lo + hi) >> 1;
+		c = strncmp_P(line, kw_cmds[mid].name, 2);
+		if(!c)
+		{
+			((void (*)(char*)) pgm_read_word(&kw_cmds[mid].fn))(line + 2);
+			return;
+		}
+		if(c < 0)
+		{
+			hi = mid - 1;
+		}
+		else
+		{
+			lo = mid + 1;
+		}
+	}
+
+	kw_error();
+}
+
+  //////////////////////
+ //  CAT: STREAMS    //
+//////////////////////
+//Index of stream name, -1 if unknown
+int stream_find(char *name)
+{
+	int t1;
+
+	for(t1 = 0; t1 < STREAMS; t1++)
+	{
+		if(!strcmp_P(name, stream_name[t1]))
+		{
+			return t1;
+		}
+	}
+
+	return -1;
+}
+
+long stream_value(int stream)
+{
+	switch(stream)
+	{
+		case STREAM_FREQ:     return f_vfo[cur_vfo];
+		case STREAM_BAND:     return cur_band;
+		case STREAM_VFO:      return cur_vfo;
+		case STREAM_SIDEBAND: return sideband;
+		case STREAM_PTT:      return (PORTA >> 3) & 1;
+		case STREAM_SMETER:   return get_s_dbm();
+	}
+
+	return 0;
+}
+
+//Push changed values as "[name] [value]" lines
+//Polling the state here coalesces all changes (encoder, keys, menus, CAT) to the latest value
+void stream_task(void)
+{
+	int t1;
+	long v;
+	unsigned long ms = get_ms();
+	char s[CAT_NOUNLEN + 14];
+
+	if(cat_mode != CAT_NATIVE || memall_pos >= 0 || catb_cnt >= 0)
+	{
+		return;
+	}
+
+	for(t1 = 0; t1 < STREAMS; t1++)
+	{
+		if(!stream_rate[t1] || ms - stream_t[t1] < stream_ms[t1])
+		{
+			continue;
+		}
+
+		v = stream_value(t1);
+		if(v == stream_v[t1])
+		{
+			continue;
+		}
+
+		if(usart_tx_free() < UART_TX_LEN / 2) //Leave room for replies, value is sent later
+		{
+			return;
+		}
+
+		strcpy_P(s, stream_name[t1]);
+		strcat_P(s, PSTR(" "));
+		int2asc(v, -1, s + strlen(s), 12);
+		usart_sendstring(s);
+		usart_send_crlf();
+		stream_v[t1] = v;
+		stream_t[t1] = ms;
+	}
+}
+
+//Computer aided tuning (CAT)
+//Fill buf1 string with incoming characters from usart, execute line on CR
+void cat_task(void)
+{
+	int ch;
+	char mbuf[14];
+
+	//Paced GET MEMALL: Next memory whenever the line fits into the TX buffer
+	if(memall_pos >= 0 && usart_tx_free() >= sizeof(mbuf))
+	{
+		int2asc(load_frequency1(memall_pos * 4), -1, mbuf, 12);
+		usart_sendstring(mbuf);
+		usart_send_crlf();
+		if(++memall_pos >= 96)
+		{
+			memall_pos = -1;
+			show_msg_P(PSTR("MEMALL."), bcolor);
+		}
+	}
+
+	usart_baud_check(0);
+
+	ch = usart_receive();
+	
+	//SYNC at start of line switches to binary frame until frame is complete or stalls
+	if(catb_cnt >= 0 || (ch == CATB_SYNC && !cat_cnt))
+	{
+		catb_rx(ch);
+		return;
+	}
+	
+	if(ch >= 97 && ch <= 122) //Convert lower case to upper case
+	{
+		ch &= ~0x20;
+	}
+
+	if(ch == ';' && cat_mode == CAT_KENWOOD) //Kenwood command complete, no echo on the display
+	{
+		PROF_START(PROF_CAT);
+		trace_put(TR_CAT, ((unsigned long) buf1[0] << 24) | ((unsigned long) buf1[1] << 16) | (buf1[2] << 8) | ';');
+		if(cat_ovf)
+		{
+			kw_error();
+		}
+		else
+		{
+			kw_exec(buf1);
+		}
+		cat_cnt = 0;
+		cat_ovf = 0;
+		memset(buf1, 0, sizeof(buf1));
+		PROF_STOP(PROF_CAT);
+		return;
+	}
+	
+	if(ch >= 32 &&ch < 128)
+	{
+		if(cat_cnt < MAXRXBUFLEN)
+		{
+	        buf1[cat_cnt++] = ch;
+		    buf1[cat_cnt] = 0;
+		}
+		else
+		{
+			cat_ovf = 1; //A clipped command must not be executed
+		}
+	}
+
+    if(ch == 13) //Command complete
+	{
+		PROF_START(PROF_CAT);
+		trace_put(TR_CAT, ((unsigned long) buf1[0] << 24) | ((unsigned long) buf1[4] << 16) | (buf1[5] << 8) | buf1[6]);
+		ch = buf1[CAT_ECHO_LEN]; //Echo as much as fits into the message line
+		buf1[CAT_ECHO_LEN] = 0;
+		show_msg(buf1, bcolor);
+		buf1[CAT_ECHO_LEN] = ch;
+		if(cat_ovf)
+		{
+			cat_error(PSTR("Too long!"));
+		}
+		else
+		{
+			cat_line(buf1);
+		}
+		cat_cnt = 0;
+		cat_ovf = 0;
+		memset(buf1, 0, sizeof(buf1));
+        PROF_STOP(PROF_CAT);
+	}
+}
+
+//Meter, peak reset, message line, temperature and voltage
+void timer_task(void)
+{
+	timer_poll();
+}	
+
+  //////////////////////////
+ //  INTERRUPT HANDLERS  //
+//////////////////////////
+//Rotary encoder
+//Every edge is timestamped with Timer1 to estimate the knob velocity
+ISR(INT2_vect)
+{ 
+	unsigned int tcnt = TCNT1;
+	unsigned int dt, v;
+	int dir;
+	
+    dir = ((PIND >> 2) & 0x03) - 2;           // Read PD2 and PD3 and convert to 1 or -1 
+    if(tuningknob + dir <= KNOB_MAX && tuningknob + dir >= -KNOB_MAX)
+    {
+		tuningknob += dir;  //Accumulate, main loop may be busy for a while
+	}	
+    
+	if(ms_ticks - enc_last_ms > ENC_IDLE_MS)
+	{
+		enc_velocity = 0; //Knob has been resting, restart with finest step
+	}
+	else
+	{
+		dt = (tcnt - enc_last_tcnt) >> 2; //16us units, Timer1 wraps after 262ms only
+		if(!dt)
+		{
+			dt = 1;
+		}	
+		
+		v = (unsigned int) (ENC_TIMER_HZ / 4) / dt;
+		if(v > ENC_VEL_MAX)
+		{
+			v = ENC_VEL_MAX;
+		}	
+		enc_velocity += ((int) (v << 4) - (int) enc_velocity) >> ENC_EMA_SHIFT;
+	}
+	
+	enc_last_tcnt = tcnt;
+	enc_last_ms = ms_ticks;
+}
+
+//UART receiver: Byte into RX buffer
+ISR(USART0_RX_vect)
+{
+	unsigned char st = UCSR0A;
+	unsigned char d = UDR0;
+	unsigned char next = (uart_rx_head + 1) & (UART_RX_LEN - 1);
+	
+	if(st & (1<<DOR)) //Character(s) lost in hardware
+	{
+		uart_overruns++;
+		trace_put(TR_UART_OVR, uart_overruns);
+	}
+	
+	if(next == uart_rx_tail)
+	{
+		uart_rx_lost++;
+		return;
+	}
+	
+	uart_rx_buf[uart_rx_head] = d;
+	uart_rx_head = next;
+}
+
+//UART data register empty: Next byte from TX buffer, interrupt off when buffer is empty
+ISR(USART0_UDRE_vect)
+{
+	if(uart_tx_tail == uart_tx_head)
+	{
+		UCSR0B &= ~(1<<UDRIE);
+		return;
+	}
+	
+	UCSR0A |= (1<<TXC); //Clear "transmit complete" for usart_flush()
+	UDR0 = uart_tx_buf[uart_tx_tail];
+	uart_tx_tail = (uart_tx_tail + 1) & (UART_TX_LEN - 1);
+	uart_tx_sent = 1;
+}
+
+//1ms tick: Timebase and ADC scan pacing
+ISR(TIMER0_COMP_vect)
+{
+	unsigned char t1;
+	
+	ms_ticks++;
+	
+	for(t1 = 0; t1 < ADC_CHANNELS; t1++)
+	{
+		if(adc_due[t1])
+		{
+			adc_due[t1]--;
+		}
+	}
+	
+	if(!adc_busy)
+	{
+		adc_start_next();
+	}	
+}
+
+//ADC conversion complete
+ISR(ADC_vect)
+{
+	unsigned int raw = ADCW;
+	unsigned char ch = adc_ch;
+	
+	PROF_START(PROF_ADC);
+	
+	if(adc_discard) //Mux has just been switched, convert again
+	{
+		adc_discard = 0;
+		ADCSRA |= (1<<ADSC);
+		PROF_STOP(PROF_ADC);
+		return;
+	}
+	
+	if(ch == SMETER_CH) //S-Meter: Oversample, decimate and apply ballistics
+	{
+		sm_sum += raw;
+		if(++sm_n < SMETER_OVERSAMPLE)
+		{
+			ADCSRA |= (1<<ADSC);
+			PROF_STOP(PROF_ADC);
+			return;
+		}
+		
+		raw = sm_sum >> 2; //12 bit
+		sm_sum = 0;
+		sm_n = 0;
+		if((raw << 3) < sm_acc) //Lower voltage = stronger signal
+		{
+			sm_acc += ((int) (raw << 3) - (int) sm_acc) >> SMETER_ATTACK_SHIFT;
+		}
+		else
+		{
+			sm_acc += ((int) (raw << 3) - (int) sm_acc) >> SMETER_DECAY_SHIFT;
+		}
+		adc_val[ch] = sm_acc >> 5;
+		adc_busy = 0;
+		PROF_STOP(PROF_ADC);
+		return;
+	}	
+	
+	adc_acc[ch] += ((int) (raw << 4) - (int) adc_acc[ch]) >> pgm_read_byte(&adc_filter[ch]);
+	adc_val[ch] = adc_acc[ch] >> 4;
+	adc_busy = 0;
+	
+	if(!ch)
+	{
+		key_sample(raw);
+	}	
+	
+	PROF_STOP(PROF_ADC);
+}
+
+//Map filtered encoder velocity to tuning step by acceleration curve
+int calc_tuningfactor(void)
+{
+	unsigned int v;
+	int t1, step;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		v = enc_velocity >> 4;
+	}
+	
+	step = pgm_read_word(&tune_accel[0][1]);
+	for(t1 = 1; t1 < TUNE_ACCEL_POINTS && v >= pgm_read_word(&tune_accel[t1][0]); t1++)
+	{
+		step = pgm_read_word(&tune_accel[t1][1]);
+	}
+	
+	if(step > TUNE_STEP_MAX)
+	{
+		step = TUNE_STEP_MAX;
+	}	
+		
+	return step;
+}	
+
+//Tune one step into direction dir (1 or -1) and snap result to step grid
+long tune_step(long f, int dir)
+{
+	long step = calc_tuningfactor();
+	
+	f += dir * step;
+	
+	return f - (f % step);
+}	
+
+  ///////////////////
+ //// U A R T   ////
+///////////////////
+//Init USART0 with rate baud_rate[idx]
+void usart_init(int idx)
+{
+	unsigned int ubrr = pgm_read_word(&baud_ubrr[idx]);
+	
+	baud_idx = idx;
+	
+    /* Set baud rate, double speed mode */
+	UBRR0H = (unsigned char)(ubrr >> 8);
+	UBRR0L = (unsigned char)ubrr;
+	UCSR0A = (1<<U2X);
+	
+	/* Enable receiver and transmitter, RX interrupt (TX interrupt is enabled when data is queued) */
+	UCSR0B = (1<<RXEN)|(1<<TXEN)|(1<<RXCIE);
+	
+	/* Set frame format: 8data, 1stop bit, NO parity */
+	UCSR0C = (1 << UCSZ00)|(1 << UCSZ01);
+	
+	if(uart_tx_head != uart_tx_tail) //Bytes left in TX buffer (switch back after timeout) are sent at the new rate
+	{
+		UCSR0B |= (1<<UDRIE);
+	}	
+}
+
+//Switch to new rate after pending output is sent, old rate is restored by usart_baud_check() if not confirmed
+void usart_set_baud(int idx)
+{
+	usart_flush(500);
+	if(baud_prev < 0)
+	{
+	    baud_prev = baud_idx;
+	}    
+	baud_t0 = get_ms();
+	usart_init(idx);
+}	
+
+//Called with valid = 1 after a valid command, with 0 on every pass
+//The first valid command at the new rate makes it permanent, otherwise the old rate returns after BAUD_CONFIRM_MS
+void usart_baud_check(int valid)
+{
+	if(baud_prev < 0)
+	{
+		return;
+	}
+	
+	if(valid)
+	{
+		baud_prev = -1;
+		eeprom_store(BAUD_ADR, baud_idx);
+		TRACE_EEPROM(BAUD_ADR, baud_idx);
+	}	
+	else if(get_ms() - baud_t0 > BAUD_CONFIRM_MS)
+	{
+		usart_init(baud_prev);
+		baud_prev = -1;
+		show_msg_P(PSTR("Baud rate restored."), bcolor);
+	}
+}	
+
+	
+//Queue byte for sending by interrupt
+//Only waits if the buffer is full (long reports), byte is dropped after UART_TX_WAIT
+void usart_transmit(unsigned char data)
+{
+	unsigned char next = (uart_tx_head + 1) & (UART_TX_LEN - 1);
+	unsigned int t = UART_TX_WAIT;
+	
+	while(next == uart_tx_tail)
+	{
+		if(!t--)
+		{
+			uart_tx_lost++;
+			return;
+		}
+		wdt_reset(); //Long reports (GET TRACE: 576 bytes = 2.4s @ 2400 Bd) are sent within one task run
+		_delay_us(10);
+	}
+	
+	uart_tx_buf[uart_tx_head] = data;
+	uart_tx_head = next;
+	UCSR0B |= (1<<UDRIE);
+}
+
+//Free bytes in TX buffer
+int usart_tx_free(void)
+{
+	return (uart_tx_tail - uart_tx_head - 1) & (UART_TX_LEN - 1);
+}	
+
+//Wait until all queued bytes have left the shift register, returns -1 after timeout ms
+int usart_flush(unsigned int timeout)
+{
+	unsigned long t0 = get_ms();
+	
+	while(uart_tx_head != uart_tx_tail || (UCSR0B & (1<<UDRIE)) || (uart_tx_sent && !(UCSR0A & (1<<TXC))))
+	{
+		if(get_ms() - t0 > timeout)
+		{
+			return -1;
+		}
+		wdt_reset();
+	}
+	
+	return 0;
+}	
+
+//Next byte from RX buffer or -1 if empty
+int usart_receive(void)
+{
+	unsigned char d;
+	
+	if(uart_rx_tail == uart_rx_head)
+	{
+		return -1;
+	}
+	
+	d = uart_rx_buf[uart_rx_tail];
+	uart_rx_tail = (uart_rx_tail + 1) & (UART_RX_LEN - 1);
+	
+	return d;
+}
+
+void usart_sendstring(char *s)
+{
+	int t1 = 0;
+	
+	while(s[t1])
+	{
+		usart_transmit(s[t1++]);
+	}
+}		
+
+void usart_sendstring_P(PGM_P s)
+{
+	char ch;
+	
+	while((ch = pgm_read_byte(s++)))
+	{
+		usart_transmit(ch);
+	}
+}		
+ 
+void usart_send_crlf(void)
+{
+	usart_transmit(13);
+	usart_transmit(10);
+}	
+
+//Send value as hex number with fixed number of digits
+void usart_sendhex(unsigned long v, int digits)
+{
+	unsigned char d;
+	
+	while(digits--)
+	{
+		d = (v >> (digits * 4)) & 0x0F;
+		usart_transmit(d < 10 ? '0' + d : 'A' - 10 + d);
+	}
+}	
+
+	
+int main(void)
+{
+	int t1;
+	
+	//Watchdog stays off until init is done
+	reset_cause = MCUCSR;
+	MCUCSR = 0;
+	wdt_disable();
+	warm_ok = (reset_cause & (1 << WDRF)) ? 1 : 0;
+	
+	cur_agc = 1;
+	cur_tone = 1;
+		
+    LCDCTRLDDR = 0xF0; //LCD CTRL PA4:PA7 blue, brown, violet, green
+    LCDDATADDR = 0xFF; //LCD DATA PC0:PC7
+    
+    init_delay(100);
+    
+    //Relays for band set PA0, PA1, PA2
+    DDRA |= 0x07;
+    
+    //PA3 TX relay output
+    DDRA |= 0x08;
+    PORTA &= ~(8); 		 //Set to RX mode
+    
+    //DDS1
+    DDS1_DDR = 0xF0; //DDS1 on PD4:PD7
+    
+    //DDS2
+    DDS2_DDR = 0xF0; //DDS2 on PB4:PB7
+
+    //PB0 for ATT
+    DDRB |= (1 << 3);
+    
+    DDRG = 0x1B; //Set: AGC (PG0:PG1), Tone (PG3:PG4)
+    
+    //ADC0 Pullup resistor
+    ADC_KEY_PORT = 0x01; //ADC        
+    
+    //ROTARY ENCODER
+    PORTD |= (1 << PD2) | (1 << PD3);//INPUT: Pullup resistors for PD2 and PD3 rotary encoder
+    
+    PORTG |= 4; //Pullup for TX/RX indicator
+        
+    //Timer 1 free running for fine time stamps (encoder)
+    TCCR1A = 0;                         // normal mode, no PWM
+    TCCR1B = (1 << CS10) | (1 << CS11); // Prescaler = 1/64 based on system clock 16 MHz, 4us per count
+	
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	
+	//Timer 0 as 1ms tick for timebase and ADC scanner
+	TCCR0 = (1<<WGM01) | (1<<CS02); //CTC mode, prescaler 64
+	OCR0 = 249;                     //250 counts = 1ms
+	TIMSK |= (1<<OCIE0);
+		
+	// Timer 3 PWM for display light
+    TCCR3A |= (1<<COM3A1) | (1<<COM3A0) | (1<<WGM30); // 8-bit PWM phase-correct
+    TCCR3B |= (1<<CS30); // No prescale
+    DDRE |= (1<<3);
+    	
+	//Interrupt definitions for rotary encoder  
+	EIMSK = (1<<INT2); // | (1<<INT3));  //enable encoder pins as interrupt source
+	EICRA = (1<<ISC20)|(1<<ISC21);                      // enable pin change interupts  
+    
+    //Reset DDS1 (AD9951)
+    DDS1_PORT |= (DDS1_RESETPIN); 
+    init_delay(100); 
+	DDS1_PORT &= ~(DDS1_RESETPIN);          
+    init_delay(100); 
+	DDS1_PORT |= (DDS1_RESETPIN);     
+         
+	//Display init
+	LCDCTRLPORT |= LCDRES;     //1
+    _delay_ms(5);
+	LCDCTRLPORT &= ~(LCDRES);  //0
+	_delay_ms(5);
+    LCDCTRLPORT |= LCDRES;     //1
+    _delay_ms(5);
+
+	lcd_init();
+	init_delay(100);
+	lcd_cls(bcolor);
+	init_delay(100);
+	
+	//Init TWI
+    twi_init();
+    
+	//UART init
+	t1 = eeprom_read_byte((uint8_t*)BAUD_ADR);
+	usart_init((t1 < BAUD_RATES) ? t1 : BAUD_DEFAULT);
+	cat_mode = (eeprom_read_byte((uint8_t*)CAT_MODE_ADR) == CAT_KENWOOD) ? CAT_KENWOOD : CAT_NATIVE;
+
+    //ADC config and ADC init, values are scanned in background from now on
+    adc_init();
+    smeter_load_cal();
+        	    
+	//Resume after watchdog reset or do a normal start
+	warm_ok = warm_resume();
+	if(!warm_ok)
+	{
+		load_start_values();
+	}	
+	warm_save();
+    
+    sei();
+    
+    //Periodic jobs
+    timer_start(meter_timer, T_METER, T_METER);
+    timer_start(peak_timer, T_PEAK, T_PEAK);
+    timer_start(temp_timer, T_TEMP, T_TEMP);
+    timer_start(volts_timer, T_VOLTS, T_VOLTS);
+    tmr_msg = timer_start(msg_timer, T_MSG, T_MSG);
+    timer_start(warm_timer, T_WARM, T_WARM);
+        
+    //Tasks in order of priority
+    sched_add(ptt_task, 0, 0, 2000);
+    sched_add(tune_task, 1, 0, 5000);
+    sched_add(cat_task, 2, 0, 20000);
+    sched_add(keys_task, 3, 10, 50000);
+    sched_add(timer_task, 4, 10, 20000);
+    sched_add(stream_task, 5, 10, 5000);
+    
+    wdt_enable(WDT_TIMEOUT);
+    
+    for(;;) 
+	{
+		sched_run();
 	}
 	return 0;
 }
@@ -0,0 +1,17 @@
+//Host test build: EEPROM is an array in host.c, erased cells read 0xFF
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+extern uint8_t host_eeprom[];
+extern unsigned long host_eeprom_writes;
+
+uint8_t eeprom_read_byte(const uint8_t*);
+void eeprom_write_byte(uint8_t*, uint8_t);
+
+#define eeprom_is_ready() 1
+#define eeprom_busy_wait() do {} while(0)
+
+#endif
@@ -0,0 +1,12 @@
+//Host test build: ISRs are plain functions, the I flag is modelled in host.c
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+void host_irq_set(unsigned char);
+
+#define ISR(v) void v(void); void v(void)
+#define EMPTY_INTERRUPT(v) void v(void) {}
+#define sei() host_irq_set(1)
+#define cli() host_irq_set(0)
+
+#endif
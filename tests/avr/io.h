@@ -0,0 +1,88 @@
+//Host test build: ATmega128 I/O registers as plain variables (storage in host.c)
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+#ifndef HOST_REG
+#define HOST_REG extern
+#endif
+
+HOST_REG volatile uint8_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF, PORTG, DDRA, DDRB, DDRC, DDRD, DDRE, DDRF, DDRG, PINA, PINB, PINC, PIND, PINE, PINF;
+HOST_REG volatile uint8_t PING, TWSR, TWBR, TWCR, TWDR, ADMUX, ADCSRA, ADCL, ADCH, SFIOR, TCCR1A, TCCR1B, OCR1AH, OCR1AL, TIMSK, ETIMSK, TCCR3A, TCCR3B, OCR3A, EIMSK;
+HOST_REG volatile uint8_t EICRA, UBRR0H, UBRR0L, UCSR0A, UCSR0B, UCSR0C, UDR0, MCUCSR, WDTCR, MCUCR, TCCR0, OCR0, TCNT0, TCCR2, OCR2, TCNT2, ASSR, SREG, TIFR;
+HOST_REG volatile uint16_t TCNT1, TCNT3, OCR1A, OCR1B, OCR3B, ICR1, ADC, ADCW;
+
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PB3 3
+#define PD2 2
+#define PD3 3
+#define PG2 2
+#define TWINT 7
+#define TWSTA 5
+#define TWSTO 4
+#define TWEN 2
+#define REFS0 6
+#define ADSC 6
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADEN 7
+#define ADIE 3
+#define ADIF 4
+#define ADFR 5
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define OCIE1A 4
+#define COM3A1 7
+#define COM3A0 6
+#define WGM30 0
+#define CS30 0
+#define INT2 2
+#define ISC20 4
+#define ISC21 5
+#define RXEN 4
+#define TXEN 3
+#define RXCIE 7
+#define TXCIE 6
+#define UDRIE 5
+#define RXEN0 4
+#define TXEN0 3
+#define RXCIE0 7
+#define UDRIE0 5
+#define U2X 1
+#define U2X0 1
+#define DOR 3
+#define DOR0 3
+#define FE 4
+#define UCSZ00 1
+#define UCSZ01 2
+#define UDRE 5
+#define UDRE0 5
+#define RXC 7
+#define RXC0 7
+#define WDRF 3
+#define BORF 2
+#define EXTRF 1
+#define PORF 0
+#define WGM01 3
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define OCIE0 1
+#define OCIE2 7
+#define WGM21 3
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define TOIE1 2
+#define RAMEND 0x10FF
+#define E2END 4095
+#define OCF1A 4
+#define TXC 6
+
+#endif
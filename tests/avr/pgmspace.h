@@ -0,0 +1,22 @@
+//Host test build: flash is ordinary memory, reads keep the type of the object
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) ((const char *) (s))
+#define PGM_P const char *
+#define pgm_read_byte(a) (*(a))
+#define pgm_read_word(a) (*(a))
+#define pgm_read_dword(a) (*(a))
+#define pgm_read_ptr(a) (*(a))
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define memcpy_P memcpy
+#define strcat_P strcat
+
+#endif
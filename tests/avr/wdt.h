@@ -0,0 +1,19 @@
+//Host test build: watchdog resets are poll points of the simulation (host_poll())
+#ifndef HOST_AVR_WDT_H
+#define HOST_AVR_WDT_H
+
+void host_poll(void);
+
+#define WDTO_15MS 0
+#define WDTO_30MS 1
+#define WDTO_60MS 2
+#define WDTO_120MS 3
+#define WDTO_250MS 4
+#define WDTO_500MS 5
+#define WDTO_1S 6
+#define WDTO_2S 7
+#define wdt_enable(x) do {} while(0)
+#define wdt_disable() do {} while(0)
+#define wdt_reset() host_poll()
+
+#endif
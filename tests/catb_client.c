@@ -0,0 +1,369 @@
+//Reference client for binary CAT frames over a serial port
+//usage: catb_client.host PORT BAUD ITEM[=VALUE]...   Get/set items in one frame, e. g. "freq=14200000 att smeter"
+//       catb_client.host PORT BAUD eeread FILE [START] EEPROM to file, START > 0 resumes into an existing file
+//       catb_client.host PORT BAUD eewrite FILE [START] File to EEPROM, only changed bytes are written
+//Every frame is repeated up to CL_RETRIES times (timeout, CRC error, wrong SEQ). A failed transfer
+//prints the address to resume from. Frame format and item codes are taken from the firmware source.
+#include "host.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define CL_TIMEOUT 500      //ms for a reply byte (TX buffer of the radio drains at 2400 Bd in 0.5s)
+#define CL_RETRIES 4
+
+//Item names in the order of CATB_FREQ...
+const char *cl_item_name[CATB_ITEMS] = {"freq", "sideband", "vfo", "att", "smeter", "band", "tone", "agc"};
+const char *cl_status_name[] = {"OK", "RANGE", "REJECT"};
+
+//Transport: serial port, replaced by the firmware itself in the host test
+void (*cl_send)(const unsigned char*, int);
+int (*cl_recv)(int);        //Next byte or -1 after timeout (ms)
+
+unsigned char cl_seq = 0;
+unsigned char cl_reply[255 + 4];          //LEN SEQ PAYLOAD CRC (without SYNC)
+unsigned long cl_retries = 0;
+
+int cl_fd = -1;
+
+void cl_serial_send(const unsigned char *b, int n)
+{
+	int r;
+
+	while(n > 0 && (r = write(cl_fd, b, n)) > 0)
+	{
+		b += r;
+		n -= r;
+	}
+}
+
+int cl_serial_recv(int ms)
+{
+	struct pollfd p = {cl_fd, POLLIN, 0};
+	unsigned char b;
+
+	if(poll(&p, 1, ms) != 1 || read(cl_fd, &b, 1) != 1)
+	{
+		return -1;
+	}
+
+	return b;
+}
+
+//Open serial port raw with 8N1, returns 0 if OK
+int cl_open(const char *dev, long baud)
+{
+	struct termios t;
+	const long rate[] = {2400, 4800, 9600, 19200, 38400, 57600, 115200};
+	const speed_t speed[] = {B2400, B4800, B9600, B19200, B38400, B57600, B115200};
+	int t1;
+
+	for(t1 = 0; t1 < 7 && rate[t1] != baud; t1++);
+	if(t1 == 7 || (cl_fd = open(dev, O_RDWR | O_NOCTTY)) < 0 || tcgetattr(cl_fd, &t))
+	{
+		return -1;
+	}
+	cfmakeraw(&t);
+	cfsetispeed(&t, speed[t1]);
+	cfsetospeed(&t, speed[t1]);
+	t.c_cflag |= CLOCAL | CREAD;
+	if(tcsetattr(cl_fd, TCSANOW, &t))
+	{
+		return -1;
+	}
+	tcflush(cl_fd, TCIOFLUSH);
+	cl_send = cl_serial_send;
+	cl_recv = cl_serial_recv;
+
+	return 0;
+}
+
+//Receive reply frame, bytes before SYNC (text of the radio) are skipped.
+//Returns payload length, -1 if timeout, bad CRC or other SEQ
+int cl_recv_frame(unsigned char seq)
+{
+	unsigned int crc = 0xFFFF;
+	int ch, t1;
+
+	do
+	{
+		if((ch = cl_recv(CL_TIMEOUT)) < 0)
+		{
+			return -1;
+		}
+	}
+	while(ch != CATB_SYNC);
+
+	for(t1 = 0; t1 < 2 || t1 < cl_reply[0] + 4; t1++)
+	{
+		if((ch = cl_recv(CL_TIMEOUT)) < 0)
+		{
+			return -1;
+		}
+		cl_reply[t1] = ch;
+	}
+
+	for(t1 = 0; t1 < cl_reply[0] + 2; t1++)
+	{
+		crc = _crc_xmodem_update(crc, cl_reply[t1]);
+	}
+	if(crc != (((unsigned int) cl_reply[t1] << 8) | cl_reply[t1 + 1]) || cl_reply[1] != seq)
+	{
+		return -1;
+	}
+
+	return cl_reply[0];
+}
+
+//Send ops in one frame and get the reply, payload starts at cl_reply + 2.
+//Returns payload length, -1 if there was no valid reply
+int cl_xfer(const unsigned char *ops, int len)
+{
+	unsigned char f[CATB_MAXLEN + 5];
+	unsigned int crc;
+	int t1, try, n;
+
+	for(try = 0; try < CL_RETRIES; try++)
+	{
+		if(try)
+		{
+			cl_retries++;
+		}
+		f[0] = CATB_SYNC;
+		f[1] = len;
+		f[2] = ++cl_seq; //New SEQ for a repeat, a late reply to the former one is not taken
+		memcpy(f + 3, ops, len);
+		for(crc = 0xFFFF, t1 = 1; t1 < len + 3; t1++)
+		{
+			crc = _crc_xmodem_update(crc, f[t1]);
+		}
+		f[len + 3] = crc >> 8;
+		f[len + 4] = crc & 0xFF;
+		cl_send(f, len + 5);
+
+		n = cl_recv_frame(cl_seq);
+		if(n == 2 && cl_reply[2] == CATB_NAK && cl_reply[3] == CATB_NAK_CRC) //Frame damaged on the way to the radio
+		{
+			continue;
+		}
+		if(n >= 0)
+		{
+			return n;
+		}
+	}
+
+	return -1;
+}
+
+//Build ops from "item" (get) and "item=value" (set) arguments, returns length or -1
+int cl_parse_ops(char **arg, int n, unsigned char *ops)
+{
+	int len = 0, t1, size;
+	char *eq;
+	long v;
+
+	while(n--)
+	{
+		if((eq = strchr(*arg, '=')))
+		{
+			*eq = 0;
+		}
+		for(t1 = 0; t1 < CATB_ITEMS && strcmp(*arg, cl_item_name[t1]); t1++);
+		if(t1 == CATB_ITEMS)
+		{
+			fprintf(stderr, "Unknown item %s\n", *arg);
+			return -1;
+		}
+		size = catb_items[t1].size;
+		if(len + 1 + (eq ? size : 0) > CATB_MAXLEN)
+		{
+			fprintf(stderr, "Too many items for one frame\n");
+			return -1;
+		}
+		if(eq)
+		{
+			v = strtol(eq + 1, NULL, 0);
+			ops[len++] = t1 | CATB_SET;
+			while(size--)
+			{
+				ops[len++] = v >> (size * 8);
+			}
+		}
+		else
+		{
+			ops[len++] = t1;
+		}
+		arg++;
+	}
+
+	return len;
+}
+
+//Print reply to ops, returns 0 if all ops are OK
+int cl_print_reply(int n)
+{
+	unsigned char *p = cl_reply + 2, *end = cl_reply + 2 + n;
+	int item, status, size, err = 0;
+	long v;
+
+	if(n == 2 && p[0] == CATB_NAK)
+	{
+		printf("NAK, op at offset %d\n", p[1]);
+		return 1;
+	}
+
+	while(p + 2 <= end)
+	{
+		item = p[0] & ~CATB_SET;
+		status = p[1];
+		size = (item < CATB_ITEMS) ? catb_items[item].size : 0;
+		for(v = 0, p += 2; size-- && p < end; p++)
+		{
+			v = (v << 8) | *p;
+		}
+		if(item == CATB_SMETER)
+		{
+			v = (int16_t) v; //dBm
+		}
+		printf("%-8s %-6s %ld\n", item < CATB_ITEMS ? cl_item_name[item] : "?", status <= CATB_REJECT ? cl_status_name[status] : "?", v);
+		err |= status != CATB_OK;
+	}
+
+	return err;
+}
+
+//Read EEPROM start...end - 1 into buf (buf[0] = EEPROM start), returns address reached (end if complete)
+unsigned int cl_ee_read(unsigned char *buf, unsigned int start, unsigned int end)
+{
+	unsigned char ops[4];
+	unsigned int adr = start, n;
+
+	while(adr < end)
+	{
+		n = (end - adr > CATB_EE_CHUNK) ? CATB_EE_CHUNK : end - adr;
+		ops[0] = CATB_EE_READ;
+		ops[1] = adr >> 8;
+		ops[2] = adr & 0xFF;
+		ops[3] = n;
+		if(cl_xfer(ops, 4) != (int) n + 4 || cl_reply[2] != CATB_EE_READ || cl_reply[3] != CATB_OK
+		   || ((cl_reply[4] << 8) | cl_reply[5]) != adr)
+		{
+			break;
+		}
+		memcpy(buf + adr - start, cl_reply + 6, n);
+		adr += n;
+	}
+
+	return adr;
+}
+
+//Write buf to EEPROM start...end - 1, changed = number of bytes the radio had to write.
+//Returns address reached (end if complete)
+unsigned int cl_ee_write(const unsigned char *buf, unsigned int start, unsigned int end, unsigned long *changed)
+{
+	unsigned char ops[3 + CATB_EE_CHUNK];
+	unsigned int adr = start, n;
+
+	while(adr < end)
+	{
+		n = (end - adr > CATB_EE_CHUNK) ? CATB_EE_CHUNK : end - adr;
+		ops[0] = CATB_EE_WRITE;
+		ops[1] = adr >> 8;
+		ops[2] = adr & 0xFF;
+		memcpy(ops + 3, buf + adr - start, n);
+		if(cl_xfer(ops, 3 + n) != 5 || cl_reply[2] != CATB_EE_WRITE || cl_reply[3] != CATB_OK
+		   || ((cl_reply[4] << 8) | cl_reply[5]) != adr + n)
+		{
+			break;
+		}
+		*changed += cl_reply[6];
+		adr += n;
+	}
+
+	return adr;
+}
+
+#ifndef CATB_CLIENT_TEST
+int main(int argc, char **argv)
+{
+	unsigned char buf[E2END + 1], ops[CATB_MAXLEN];
+	unsigned int start = 0, end, adr;
+	unsigned long changed = 0;
+	FILE *f;
+	int n;
+
+	if(argc < 4)
+	{
+		fprintf(stderr, "usage: %s PORT BAUD ITEM[=VALUE]... | eeread FILE [START] | eewrite FILE [START]\n", argv[0]);
+		return 2;
+	}
+	if(cl_open(argv[1], atol(argv[2])))
+	{
+		fprintf(stderr, "Can't open %s at %s Bd\n", argv[1], argv[2]);
+		return 2;
+	}
+
+	if(!strcmp(argv[3], "eeread") || !strcmp(argv[3], "eewrite"))
+	{
+		if(argc < 5)
+		{
+			fprintf(stderr, "File missing\n");
+			return 2;
+		}
+		if(argc > 5)
+		{
+			start = strtoul(argv[5], NULL, 0);
+		}
+		if(start > E2END)
+		{
+			fprintf(stderr, "START beyond EEPROM\n");
+			return 2;
+		}
+
+		if(!strcmp(argv[3], "eeread"))
+		{
+			adr = cl_ee_read(buf, start, E2END + 1);
+			if(!(f = fopen(argv[4], start ? "r+b" : "wb")) || fseek(f, start, SEEK_SET)
+			   || fwrite(buf, 1, adr - start, f) != adr - start || fclose(f))
+			{
+				fprintf(stderr, "Can't write %s\n", argv[4]);
+				return 2;
+			}
+			end = E2END + 1;
+		}
+		else
+		{
+			if(!(f = fopen(argv[4], "rb")))
+			{
+				fprintf(stderr, "Can't read %s\n", argv[4]);
+				return 2;
+			}
+			end = fread(buf, 1, sizeof(buf), f);
+			fclose(f);
+			adr = (end > start) ? cl_ee_write(buf + start, start, end, &changed) : start;
+			printf("%lu bytes changed\n", changed);
+		}
+
+		printf("%u bytes, %lu frames repeated\n", adr - start, cl_retries);
+		if(adr < end)
+		{
+			printf("Stopped at 0x%03X, resume with: %s %s %s %s %s %u\n", adr, argv[0], argv[1], argv[2], argv[3], argv[4], adr);
+			return 1;
+		}
+		return 0;
+	}
+
+	if((n = cl_parse_ops(argv + 3, argc - 3, ops)) < 0)
+	{
+		return 2;
+	}
+	if((n = cl_xfer(ops, n)) < 0)
+	{
+		printf("No reply\n");
+		return 1;
+	}
+
+	return cl_print_reply(n);
+}
+#endif
@@ -0,0 +1,102 @@
+//Host test build: storage for the stubbed AVR hardware and the interrupt model
+//Interrupts are taken only at interrupt points (sei(), end of ATOMIC_BLOCK, wdt_reset(), delays) while I = 1
+#include <stdint.h>
+#include <stdio.h>
+
+#define HOST_REG
+#include "avr/io.h"
+#include "avr/eeprom.h"
+#include "avr/interrupt.h"
+#include "util/crc16.h"
+
+uint8_t _end, __stack;
+
+uint8_t host_eeprom[E2END + 1] = {[0 ... E2END] = 0xFF};
+unsigned long host_eeprom_writes;
+
+unsigned char host_irq = 1;   //I flag
+unsigned char host_in_isr;    //Device model is running
+unsigned long host_irq_points;
+void (*host_device)(void);    //Interrupt sources of the test, called at interrupt points with I = 0
+
+//Interrupt point: Let the device model run its ISRs if interrupts are enabled
+void host_irq_point(void)
+{
+	host_irq_points++;
+	if(host_irq && host_device && !host_in_isr)
+	{
+		host_irq = 0;
+		host_in_isr = 1;
+		host_device();
+		host_in_isr = 0;
+		host_irq = 1;
+	}
+}
+
+void host_irq_set(unsigned char on)
+{
+	host_irq = on;
+	host_irq_point();
+}
+
+unsigned char host_atomic_begin(unsigned char forceon)
+{
+	unsigned char sreg = host_irq;
+
+	host_irq_point();
+	host_irq = 0;
+
+	return forceon ? 1 : sreg;
+}
+
+void host_atomic_end(unsigned char *sreg)
+{
+	host_irq_set(*sreg);
+}
+
+void host_poll(void)
+{
+	host_irq_point();
+}
+
+void _delay_ms(double ms)
+{
+	host_irq_point();
+}
+
+void _delay_us(double us)
+{
+	host_irq_point();
+}
+
+uint8_t eeprom_read_byte(const uint8_t *adr)
+{
+	return host_eeprom[(uintptr_t) adr & E2END];
+}
+
+void eeprom_write_byte(uint8_t *adr, uint8_t v)
+{
+	host_eeprom[(uintptr_t) adr & E2END] = v;
+	host_eeprom_writes++;
+}
+
+//Bitwise version from the avr-libc documentation
+uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+	int t1;
+
+	crc = crc ^ ((uint16_t) data << 8);
+	for(t1 = 0; t1 < 8; t1++)
+	{
+		if(crc & 0x8000)
+		{
+			crc = (crc << 1) ^ 0x1021;
+		}
+		else
+		{
+			crc <<= 1;
+		}
+	}
+
+	return crc;
+}
@@ -0,0 +1,78 @@
+//Host test build: The complete firmware compiled for the PC with the stub headers of this directory
+//Firmware main() is renamed, every test has its own main() and includes this file once
+#include <stdio.h>
+#include <stdlib.h>
+
+#define main midi6_main
+#include "../midi6.c"
+#undef main
+
+extern unsigned char host_irq, host_in_isr;
+extern unsigned long host_irq_points;
+extern void (*host_device)(void);
+void host_irq_point(void);
+
+int host_fails;
+
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); host_fails++; } } while(0)
+
+//UART output of the firmware, collected by running the UDRE interrupt
+char host_tx[8192];
+int host_tx_len;
+
+void host_uart(void)
+{
+	while(UCSR0B & (1 << UDRIE))
+	{
+		if(uart_tx_tail != uart_tx_head && host_tx_len < (int) sizeof(host_tx) - 1)
+		{
+			USART0_UDRE_vect();
+			host_tx[host_tx_len++] = UDR0;
+		}
+		else
+		{
+			USART0_UDRE_vect();
+		}
+	}
+	host_tx[host_tx_len] = 0;
+}
+
+//Get everything sent so far, buffer is cleared
+char *host_tx_get(void)
+{
+	host_irq_point();
+	host_tx_len = 0;
+	return host_tx;
+}
+
+//Receive bytes through the RX interrupt
+void host_rx(const char *s, int n)
+{
+	while(n--)
+	{
+		UDR0 = *s++;
+		USART0_RX_vect();
+	}
+}
+
+//Advance the timebase by n ms
+void host_ms(int n)
+{
+	while(n--)
+	{
+		TIMER0_COMP_vect();
+	}
+}
+
+//Default device: UART transmitter only
+void host_init(void)
+{
+	host_device = host_uart;
+	host_irq = 1;
+}
+
+int host_result(const char *name)
+{
+	printf("%s: %s\n", name, host_fails ? "FAILED" : "OK");
+	return host_fails ? 1 : 0;
+}
@@ -0,0 +1,179 @@
+//CAT tables: Sort order needed by the binary searches, names of binary items, dispatch of text commands
+//Kenwood split: FR/FT replies and the VFO keyed by ptt_task()
+//Lines through the UART: Too long lines and replies of several lines within a batch are refused
+//Modal screens: A menu still takes PTT and frequency, a TX screen nothing
+#include "host.h"
+
+//Execute text line, returns reply
+char *cat(const char *s)
+{
+	char line[MAXRXBUFLEN + 1];
+
+	strcpy(line, s); //cat_line() modifies the line
+	host_tx_get();
+	cat_line(line);
+	return host_tx_get();
+}
+
+//Receive text through the UART, returns reply
+char *uart(const char *s)
+{
+	host_tx_get();
+	while(*s)
+	{
+		host_rx(s++, 1);
+		cat_task();
+	}
+	return host_tx_get();
+}
+
+//Execute Kenwood command (without ';'), returns reply
+char *kw(const char *s)
+{
+	char line[MAXRXBUFLEN + 1];
+
+	strcpy(line, s);
+	host_tx_get();
+	kw_exec(line);
+	return host_tx_get();
+}
+
+//Last frequency set on DDS1, from the event trace
+long dds1(void)
+{
+	int t1;
+	unsigned char i;
+
+	for(t1 = 1; t1 <= TRACE_LEN; t1++)
+	{
+		i = (trace_head - t1) & (TRACE_LEN - 1);
+		if(trace_ev[i] == TR_DDS1)
+		{
+			return trace_arg[i];
+		}
+	}
+
+	return -1;
+}
+
+//Key and unkey by the PTT input, returns TX frequency
+long ptt(void)
+{
+	long f;
+
+	PING &= ~(1 << PG2);
+	ptt_task();
+	f = dds1();
+	PING |= (1 << PG2);
+	ptt_task();
+
+	return f;
+}
+
+int main(void)
+{
+	char name[CAT_NOUNLEN + 2];
+	unsigned int t1;
+
+	host_init();
+
+	for(t1 = 0; t1 < CAT_CMDS; t1++)
+	{
+		CHECK(cat_cmds[t1].name[0] == 'S' || cat_cmds[t1].name[0] == 'G');
+		CHECK(strlen(cat_cmds[t1].name) <= CAT_NOUNLEN + 1);
+		CHECK(cat_find((char*) cat_cmds[t1].name) == &cat_cmds[t1]);
+		if(t1)
+		{
+			CHECK(strcmp(cat_cmds[t1 - 1].name, cat_cmds[t1].name) < 0);
+			if(strcmp(cat_cmds[t1 - 1].name, cat_cmds[t1].name) >= 0)
+			{
+				printf("cat_cmds[]: \"%s\" before \"%s\"\n", cat_cmds[t1 - 1].name, cat_cmds[t1].name);
+			}
+		}
+	}
+
+	for(t1 = 1; t1 < KW_CMDS; t1++)
+	{
+		CHECK(strcmp(kw_cmds[t1 - 1].name, kw_cmds[t1].name) < 0);
+	}
+
+	for(t1 = 0; t1 < CATB_ITEMS; t1++)
+	{
+		strcpy(name, catb_items[t1].name);
+		CHECK(!name[0] || cat_find(name));
+	}
+
+	CHECK(!strcmp(cat("SET SMCAL 3 -4"), ""));
+	CHECK(!strcmp(cat("GET SMCAL 3"), "-4\r\n"));
+	CHECK(!strcmp(cat("SET SMCAL 3 41"), "ERR\r\n"));
+	CHECK(!strcmp(cat("SET SMCAL 3"), "ERR\r\n"));
+	CHECK(!strcmp(cat("SET MCAL 3 0"), "ERR\r\n"));
+	CHECK(!strcmp(cat("GET VFOX"), "ERR\r\n"));
+	CHECK(!strcmp(cat("SET SMCAL 3 0;GET SMCAL 3"), "0;\r\n"));
+
+	//Lines through the UART, the last command of a too long line must not be executed clipped
+	CHECK(!strcmp(uart("GET SMCAL 3\r"), "0\r\n"));
+	CHECK(!strcmp(uart("SET SMCAL 3 1;SET SMCAL 3 2;SET SMCAL 3 3;SET SMCAL 3 4;SET SMCAL 3 15\r"), "ERR\r\n"));
+	CHECK(smeter_cal[3] == 0);
+	CHECK(!strcmp(uart("SET SMCAL 3 1;SET SMCAL 3 2;SET SMCAL 3 3;GET SMCAL 3\r"), "3;\r\n"));
+	CHECK(!strcmp(uart("GET SMCAL 3\r"), "3\r\n"));
+	CHECK(!strcmp(cat("GET VFO;GET TRACE;GET SCHED;GET MEMALL;GET VFO"), "0;ERR;ERR;ERR;0;\r\n"));
+
+	//Kenwood: RX A, TX B (usual split of hamlib), then RX B, TX A
+	cat_mode = CAT_KENWOOD;
+	cur_band = 3;
+	f_vfo[0] = 14010000;
+	f_vfo[1] = 14020000;
+	cur_vfo = 0;
+	alt_vfo = 1;
+	PING |= (1 << PG2);
+	CHECK(!strcmp(kw("FR0"), "") && cur_vfo == 0 && alt_vfo == 1 && !split);
+	CHECK(!strcmp(kw("FT1"), "") && split);
+	CHECK(!strcmp(kw("FR"), "FR0;"));
+	CHECK(!strcmp(kw("FT"), "FT1;"));
+	CHECK(ptt() == 14020000 && dds1() == 14010000);
+
+	CHECK(!strcmp(kw("FR1"), "") && cur_vfo == 1 && alt_vfo == 0 && !split);
+	CHECK(!strcmp(kw("FT0"), "") && split);
+	CHECK(!strcmp(kw("FR"), "FR1;"));
+	CHECK(!strcmp(kw("FT"), "FT0;"));
+	CHECK(ptt() == 14010000 && dds1() == 14020000);
+
+	//Split mode 2 of the menu is reported the way ptt_task() uses it
+	split = 2;
+	vfo_s[0] = 1;
+	vfo_s[1] = 0;
+	CHECK(!strcmp(kw("FT"), "FT0;"));
+	CHECK(!strcmp(kw("FR"), "FR1;"));
+	CHECK(ptt() == 14010000 && dds1() == 14020000);
+
+	CHECK(!strcmp(kw("FT1"), "") && !split);
+	CHECK(!strcmp(kw("FT"), "FT1;"));
+
+	//Menu open: PTT and frequency within the band, no other settings
+	cat_locked = CAT_LOCK_SET;
+	CHECK(!strcmp(kw("TX"), "") && (PORTA & (1 << 3)));
+	CHECK(!strcmp(kw("RX"), "") && !(PORTA & (1 << 3)));
+	CHECK(!strcmp(kw("FA00014030000"), "") && f_vfo[0] == 14030000);
+	CHECK(!strcmp(kw("FA00007030000"), "?;") && cur_band == 3);
+	CHECK(!strcmp(kw("FR0"), "?;") && cur_vfo == 1);
+	CHECK(!strcmp(kw("MD1"), "?;"));
+	cat_mode = CAT_NATIVE;
+	CHECK(!strcmp(cat("SET PTT 1"), "") && (PORTA & (1 << 3)));
+	CHECK(!strcmp(cat("SET PTT 0"), "") && !(PORTA & (1 << 3)));
+	CHECK(!strcmp(cat("SET FREQ 14040000"), "") && f_vfo[1] == 14040000);
+	CHECK(!strcmp(cat("SET BAND 2"), "ERR\r\n") && cur_band == 3);
+	CHECK(!strcmp(cat("GET BAND"), "3\r\n"));
+
+	//TX screen open: Nothing is changed
+	cat_locked = CAT_LOCK_ALL;
+	CHECK(!strcmp(cat("SET PTT 1"), "ERR\r\n") && !(PORTA & (1 << 3)));
+	CHECK(!strcmp(cat("SET FREQ 14050000"), "ERR\r\n") && f_vfo[1] == 14040000);
+	cat_mode = CAT_KENWOOD;
+	CHECK(!strcmp(kw("TX"), "?;") && !(PORTA & (1 << 3)));
+	CHECK(!strcmp(kw("FB00014050000"), "?;") && f_vfo[1] == 14040000);
+	cat_locked = 0;
+	cat_mode = CAT_NATIVE;
+
+	return host_result("test_cat");
+}
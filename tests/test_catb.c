@@ -0,0 +1,277 @@
+//Binary CAT frames: CRC, replies with several ops, NAK, EEPROM chunks
+//A SET op runs the text command handler, its notification must not end up inside the reply frame.
+//Reference client against the firmware: Repeats after damaged or lost frames, EEPROM transfer with resume
+#define CATB_CLIENT_TEST
+#include "catb_client.c"
+
+unsigned char reply[CATB_MAXLEN + 8];
+int reply_len;
+
+//Send frame SYNC LEN SEQ OPS CRC through the UART and run cat_task() until it is processed,
+//crc_err != 0 corrupts the CRC. Returns payload length of reply, -1 if no valid reply frame
+int frame(unsigned char seq, const unsigned char *ops, int len, int crc_err)
+{
+	unsigned char f[CATB_MAXLEN + 5];
+	unsigned int crc = 0xFFFF;
+	int t1;
+
+	f[0] = CATB_SYNC;
+	f[1] = len;
+	f[2] = seq;
+	memcpy(f + 3, ops, len);
+	for(t1 = 1; t1 < len + 3; t1++)
+	{
+		crc = _crc_xmodem_update(crc, f[t1]);
+	}
+	crc ^= crc_err;
+	f[len + 3] = crc >> 8;
+	f[len + 4] = crc & 0xFF;
+
+	host_tx_get();
+	host_rx((char*) f, len + 5);
+	for(t1 = 0; t1 < len + 5; t1++)
+	{
+		cat_task();
+	}
+	host_irq_point(); //Drain UART, reply may contain 0 bytes
+	reply_len = host_tx_len;
+	memcpy(reply, host_tx, reply_len < (int) sizeof(reply) ? reply_len : (int) sizeof(reply));
+	host_tx_len = 0;
+
+	if(reply_len < 5 || reply[0] != CATB_SYNC || reply[1] + 5 != reply_len || reply[2] != seq)
+	{
+		return -1;
+	}
+	for(crc = 0xFFFF, t1 = 1; t1 < reply_len - 2; t1++)
+	{
+		crc = _crc_xmodem_update(crc, reply[t1]);
+	}
+	if(crc != (((unsigned int) reply[reply_len - 2] << 8) | reply[reply_len - 1]))
+	{
+		return -1;
+	}
+
+	return reply[1];
+}
+
+//Link between client and firmware, with faults
+int fw_pos;
+int fw_corrupt = 0;    //Frames to be damaged on the way to the radio
+int fw_drop = 0;       //Replies to be lost
+int fw_pass = -1;      //Frames answered before the link breaks, -1 = no break
+int fw_lost;
+
+void fw_send(const unsigned char *b, int n)
+{
+	unsigned char ch;
+	int t1;
+
+	host_tx_get();
+	for(t1 = 0; t1 < n; t1++)
+	{
+		ch = b[t1];
+		if(t1 == 3 && fw_corrupt)
+		{
+			ch ^= 0x10;
+			fw_corrupt--;
+		}
+		host_rx((char*) &ch, 1);
+		cat_task();
+	}
+	host_irq_point();
+	fw_pos = 0;
+	fw_lost = 0;
+	if(fw_drop)
+	{
+		fw_drop--;
+		fw_lost = 1;
+	}
+	if(fw_pass >= 0 && !fw_pass--)
+	{
+		fw_pass = 0;
+		fw_lost = 1;
+	}
+}
+
+int fw_recv(int ms)
+{
+	if(fw_lost || fw_pos >= host_tx_len)
+	{
+		host_ms(ms);
+		return -1;
+	}
+
+	return host_tx[fw_pos++];
+}
+
+int main(void)
+{
+	char a0[] = "freq=14100000", a1[] = "att=0", a2[] = "smeter", a3[] = "band", a4[] = "mode";
+	char *arg[] = {a0, a1, a2, a3}, *bad[] = {a3, a4};
+	unsigned char ee[E2END + 1];
+	unsigned long changed = 0, diff = 0;
+	unsigned int adr;
+	unsigned int crc = 0xFFFF;
+	const char *check = "123456789";
+	unsigned char op[CATB_MAXLEN];
+	int t1;
+
+	host_init();
+
+	//CRC-16/XMODEM with start 0xFFFF (CCITT-FALSE): Check value
+	while(*check)
+	{
+		crc = _crc_xmodem_update(crc, *check++);
+	}
+	CHECK(crc == 0x29B1);
+
+	//GET VFO, GET BAND in one frame
+	cur_vfo = 0;
+	cur_band = 2;
+	op[0] = CATB_VFO;
+	op[1] = CATB_BAND;
+	CHECK(frame(1, op, 2, 0) == 6);
+	CHECK(reply[3] == CATB_VFO && reply[4] == CATB_OK && reply[5] == 0);
+	CHECK(reply[6] == CATB_BAND && reply[7] == CATB_OK && reply[8] == 2);
+
+	//SET ATT, SET BAND, SET TONE, SET AGCS, SET VFO: Native mode notifications would corrupt the frame
+	cat_mode = CAT_NATIVE;
+	op[0] = CATB_ATT | CATB_SET;
+	op[1] = 1;
+	op[2] = CATB_BAND | CATB_SET;
+	op[3] = 3;
+	op[4] = CATB_TONE | CATB_SET;
+	op[5] = 2;
+	op[6] = CATB_AGC | CATB_SET;
+	op[7] = 1;
+	op[8] = CATB_VFO | CATB_SET;
+	op[9] = 1;
+	CHECK(frame(2, op, 10, 0) == 15);
+	for(t1 = 0; t1 < 5; t1++)
+	{
+		CHECK(reply[3 + t1 * 3] == op[t1 * 2] && reply[4 + t1 * 3] == CATB_OK && reply[5 + t1 * 3] == op[t1 * 2 + 1]);
+	}
+	CHECK(cur_att == 1 && cur_band == 3 && cur_tone == 2 && cur_agc == 1 && cur_vfo == 1);
+
+	//Value out of range
+	op[0] = CATB_BAND | CATB_SET;
+	op[1] = 6;
+	CHECK(frame(3, op, 2, 0) == 3);
+	CHECK(reply[4] == CATB_RANGE && reply[5] == 3);
+
+	//Unknown op and SET of a read only item: NAK and offset, nothing executed
+	op[0] = CATB_ATT | CATB_SET;
+	op[1] = 0;
+	op[2] = CATB_ITEMS;
+	CHECK(frame(4, op, 3, 0) == 2);
+	CHECK(reply[3] == CATB_NAK && reply[4] == 2 && cur_att == 1);
+	op[0] = CATB_SMETER | CATB_SET;
+	CHECK(frame(5, op, 3, 0) == 2);
+	CHECK(reply[3] == CATB_NAK && reply[4] == 0);
+
+	//CRC error
+	op[0] = CATB_VFO;
+	crc = catb_crc_errors;
+	CHECK(frame(6, op, 1, 0x0100) == 2);
+	CHECK(reply[3] == CATB_NAK && reply[4] == CATB_NAK_CRC && catb_crc_errors == crc + 1);
+
+	//EEPROM chunks: Write, read back, address out of range
+	op[0] = CATB_EE_WRITE;
+	op[1] = 0x01;
+	op[2] = 0x00;
+	for(t1 = 0; t1 < CATB_EE_CHUNK; t1++)
+	{
+		op[3 + t1] = t1 * 7;
+	}
+	CHECK(frame(7, op, 3 + CATB_EE_CHUNK, 0) == 5);
+	CHECK(reply[4] == CATB_OK && reply[5] == 0x01 && reply[6] == CATB_EE_CHUNK && reply[7] == CATB_EE_CHUNK);
+	CHECK(host_eeprom[0x100 + 5] == 35);
+	CHECK(frame(8, op, 3 + CATB_EE_CHUNK, 0) == 5);
+	CHECK(reply[4] == CATB_OK && reply[7] == 0); //Unchanged bytes are not written
+
+	op[0] = CATB_EE_READ;
+	op[3] = CATB_EE_CHUNK;
+	CHECK(frame(9, op, 4, 0) == 4 + CATB_EE_CHUNK);
+	CHECK(reply[4] == CATB_OK && reply[5] == 0x01 && reply[6] == 0x00);
+	for(t1 = 0; t1 < CATB_EE_CHUNK; t1++)
+	{
+		CHECK(reply[7 + t1] == (unsigned char) (t1 * 7));
+	}
+
+	op[1] = E2END >> 8;
+	op[2] = E2END & 0xFF;
+	CHECK(frame(10, op, 4, 0) == 4);
+	CHECK(reply[4] == CATB_RANGE);
+
+	//Menu open: Frequency is taken, other settings are rejected, EEPROM is not written
+	cat_locked = CAT_LOCK_SET;
+	op[0] = CATB_FREQ | CATB_SET;
+	op[1] = 0x00;
+	op[2] = 0xD6;
+	op[3] = 0x3A;
+	op[4] = 0x10; //14039568 Hz
+	op[5] = CATB_ATT | CATB_SET;
+	op[6] = 0;
+	CHECK(frame(11, op, 7, 0) == 9);
+	CHECK(reply[4] == CATB_OK && f_vfo[cur_vfo] == 14039568);
+	CHECK(reply[10] == CATB_REJECT && reply[11] == 1 && cur_att == 1);
+	op[0] = CATB_EE_WRITE;
+	op[1] = 0x01;
+	op[2] = 0x00;
+	op[3] = 0;
+	CHECK(frame(12, op, 4, 0) == 5);
+	CHECK(reply[4] == CATB_REJECT && host_eeprom[0x100] == 0);
+	cat_locked = 0;
+
+	//Client: Get and set several items in one frame
+	cl_send = fw_send;
+	cl_recv = fw_recv;
+	cur_band = 3;
+	CHECK(cl_parse_ops(bad, 2, op) < 0);
+	t1 = cl_parse_ops(arg, 4, op);
+	CHECK(t1 == 1 + 4 + 1 + 1 + 1 + 1);
+	CHECK(cl_xfer(op, t1) == 6 + 3 + 4 + 3);
+	CHECK(cl_reply[3] == CATB_OK && f_vfo[cur_vfo] == 14100000);
+	CHECK(cl_reply[9] == CATB_OK && cur_att == 0);
+	CHECK(cl_reply[15] == CATB_BAND && cl_reply[17] == 3);
+
+	//Damaged frame (NAK CRC) and lost reply are repeated
+	op[0] = CATB_VFO;
+	fw_corrupt = 1;
+	CHECK(cl_xfer(op, 1) == 3 && cl_reply[4] == cur_vfo && cl_retries == 1);
+	fw_drop = 1;
+	CHECK(cl_xfer(op, 1) == 3 && cl_reply[4] == cur_vfo && cl_retries == 2);
+	fw_drop = CL_RETRIES;
+	CHECK(cl_xfer(op, 1) < 0);
+
+	//EEPROM write, link breaks after 3 chunks, resume from the address reached.
+	//Chunk 4 is written, but its reply is lost: It is unchanged when it is sent again
+	for(t1 = 0; t1 <= E2END; t1++)
+	{
+		ee[t1] = t1 * 13 + 5;
+		diff += (t1 >= 0x200 && t1 < 0x32C && (t1 < 0x260 || t1 >= 0x280) && ee[t1] != host_eeprom[t1]);
+	}
+	fw_pass = 3;
+	adr = cl_ee_write(ee + 0x200, 0x200, 0x32C, &changed);
+	CHECK(adr == 0x200 + 3 * CATB_EE_CHUNK);
+	fw_pass = -1;
+	adr = cl_ee_write(ee + adr, adr, 0x32C, &changed);
+	CHECK(adr == 0x32C && changed == diff);
+	CHECK(!memcmp(host_eeprom + 0x200, ee + 0x200, 0x12C));
+	changed = 0;
+	CHECK(cl_ee_write(ee + 0x200, 0x200, 0x32C, &changed) == 0x32C && !changed);
+
+	//Read all of the EEPROM with a break
+	memset(ee, 0, sizeof(ee));
+	fw_pass = 10;
+	adr = cl_ee_read(ee, 0, E2END + 1);
+	CHECK(adr == 10 * CATB_EE_CHUNK);
+	fw_pass = -1;
+	CHECK(cl_ee_read(ee + adr, adr, E2END + 1) == E2END + 1);
+	CHECK(!memcmp(host_eeprom, ee, E2END + 1));
+
+	//Back in text mode after the frames
+	CHECK(catb_cnt < 0);
+
+	return host_result("test_catb");
+}
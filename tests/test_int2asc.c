@@ -0,0 +1,193 @@
+//int2asc(): Subtraction version against the former division version
+//All frequencies 0..CAT_FMAX, all values -10^6..10^6 for every dec, random 32 bit values, buffer limits
+//Also prints the run time of both versions on the PC (which divides in hardware, unlike the AVR where
+//every long division is a library call) and the average number of subtraction steps
+#include <time.h>
+#include "host.h"
+
+//Former int2asc() (division by powers of ten), writes 12 bytes, wrong for negative numbers with 10 digits
+int int2asc_div(long num, int dec, char *buf, int buflen)
+{
+	int i, c, xp = 0, neg = 0;
+	long n, dd = 1E09;
+
+	if(!num)
+	{
+		*buf++ = '0';
+		*buf = 0;
+		return 1;
+	}
+
+	if(num < 0)
+	{
+		neg = 1;
+		n = num * -1;
+	}
+	else
+	{
+		n = num;
+	}
+
+	for(i = 0; i < 12; i++)
+	{
+		*(buf + i) = 0;
+	}
+
+	c = 9;
+	while(dd)
+	{
+		i = n / dd;
+		n = n - i * dd;
+
+		*(buf + 9 - c + xp) = i + 48;
+		dd /= 10;
+		if(c == dec && dec)
+		{
+			*(buf + 9 - c + ++xp) = '.';
+		}
+		c--;
+	}
+
+	i = 0;
+	while(*(buf + i) == 48)
+	{
+		*(buf + i++) = 32;
+	}
+
+	if(neg)
+	{
+		*(buf + --i) = '-';
+	}
+
+	c = 0;
+	while(*(buf + i))
+	{
+		*(buf + c++) = *(buf + i++);
+	}
+	*(buf + c) = 0;
+
+	return c;
+}
+
+unsigned long mismatches;
+
+void compare(long v, int dec)
+{
+	char a[16], b[16 + 1], *ref = b + 1;
+	int la, lb;
+
+	la = int2asc(v, dec, a, 13);
+	if(v <= -1000000000) //Former version fails here: Same as positive value with sign
+	{
+		ref = b;
+		ref[0] = '-';
+		lb = int2asc(-v, dec, ref + 1, 12) + 1;
+	}
+	else
+	{
+		lb = int2asc_div(v, dec, ref, 13);
+	}
+
+	if(la != lb || strcmp(a, ref))
+	{
+		if(++mismatches < 10)
+		{
+			printf("%ld dec %d: \"%s\" (%d), former \"%s\" (%d)\n", v, dec, a, la, ref, lb);
+		}
+	}
+}
+
+//Output is cut at buflen - 1 chars, nothing is written behind buf[buflen - 1]
+void test_buflen(long v, int dec)
+{
+	char full[16], buf[16];
+	int len, t1, n;
+
+	len = int2asc(v, dec, full, sizeof(full));
+	for(n = 0; n <= 13; n++)
+	{
+		memset(buf, 'x', sizeof(buf));
+		t1 = int2asc(v, dec, buf, n);
+		CHECK(buf[n] == 'x');
+		if(n)
+		{
+			CHECK(t1 == (len < n - 1 ? len : n - 1) && !strncmp(buf, full, t1) && !buf[t1]);
+		}
+	}
+
+	//Fixed width: Right aligned, same digits
+	if(len <= 11)
+	{
+		int2asc_fixed(v, dec, buf, 11);
+		CHECK(strlen(buf) == 11 && !strcmp(buf + 11 - len, full) && (len == 11 || buf[10 - len] == ' '));
+	}
+}
+
+//Former version needs 20 long divisions per call
+void bench(void)
+{
+	char s[16];
+	long f, n, steps = 0;
+	clock_t t0, t1, t2;
+
+	t0 = clock();
+	for(f = 1000000; f < 31000000; f += 3)
+	{
+		int2asc(f, -1, s, sizeof(s));
+	}
+	t1 = clock();
+	for(f = 1000000; f < 31000000; f += 3)
+	{
+		int2asc_div(f, -1, s, sizeof(s));
+	}
+	t2 = clock();
+
+	for(f = 1000000; f < 31000000; f += 3)
+	{
+		for(n = f; n; n /= 10)
+		{
+			steps += n % 10;
+		}
+	}
+
+	printf("int2asc: %.1f ns per call, former version %.1f ns (PC)\n", (t1 - t0) * 1e9 / CLOCKS_PER_SEC / 1e7, (t2 - t1) * 1e9 / CLOCKS_PER_SEC / 1e7);
+	printf("int2asc: %.1f subtraction steps per frequency on average\n", steps / 1e7);
+}
+
+int main(void)
+{
+	long v, t1;
+	int dec, decs[] = {-1, 0, 1, 2, 3, 9};
+	unsigned long r = 1;
+	long edge[] = {1, 9, 10, 99, 100, 999999999, 1000000000, 2147483647, -1, -9, -10, -99, -100, -999999999, -1000000000, -2147483647 - 1};
+
+	host_init();
+
+	for(v = 0; v <= CAT_FMAX; v++)
+	{
+		compare(v, -1);
+	}
+
+	for(dec = 0; dec < 6; dec++)
+	{
+		for(v = -1000000; v <= 1000000; v++)
+		{
+			compare(v, decs[dec]);
+		}
+		for(t1 = 0; t1 < 1000000; t1++)
+		{
+			r = (r * 1103515245 + 12345) & 0xFFFFFFFF;
+			compare((int32_t) r, decs[dec]);
+		}
+		for(t1 = 0; t1 < sizeof(edge) / sizeof(edge[0]); t1++)
+		{
+			compare(edge[t1], decs[dec]);
+			test_buflen(edge[t1], decs[dec]);
+		}
+	}
+	CHECK(!mismatches);
+
+	bench();
+
+	return host_result("test_int2asc");
+}
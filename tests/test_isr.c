@@ -0,0 +1,184 @@
+//ISR interleaving: Discrete event simulation of the encoder, timer and UART RX interrupts against the
+//main context accessors (knob_get/ack, get_ms, usart_receive, trace_put)
+//Interrupts are due at random interrupt points and are delivered as soon as the I flag allows it
+#include "host.h"
+
+#define STEPS 200000
+
+unsigned long rnd_state = 12345;
+unsigned long due_enc, due_tick, due_rx;   //Interrupt point at which the next interrupt is raised
+unsigned long enc_accepted;                //Sum of detents the ISR has counted
+long enc_sum;
+unsigned long ticks, rx_sent, lat_max;
+unsigned char rx_next;
+int irq_in_cli;                            //Interrupts delivered while main had them off (must stay 0)
+int src_enc, src_rx;                       //Sources switched on by the test (timer is always on)
+
+unsigned int rnd(unsigned int n)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 16) % n;
+}
+
+//Note delivery latency (interrupt points) of an interrupt raised at point due
+void latency(unsigned long due)
+{
+	if(host_irq_points - due > lat_max)
+	{
+		lat_max = host_irq_points - due;
+	}
+}
+
+void device(void)
+{
+	int knob;
+
+	if(host_irq)
+	{
+		irq_in_cli++;
+	}
+
+	if(src_enc && due_enc <= host_irq_points)
+	{
+		latency(due_enc);
+		PIND = rnd(2) ? (3 << 2) : (1 << 2); //dir = +1 or -1
+		knob = tuningknob;
+		INT2_vect();
+		enc_sum += tuningknob - knob;
+		enc_accepted++;
+		due_enc = host_irq_points + 1 + rnd(20);
+	}
+
+	if(due_tick <= host_irq_points)
+	{
+		latency(due_tick);
+		TIMER0_COMP_vect();
+		ticks++;
+		due_tick = host_irq_points + 1 + rnd(10);
+	}
+
+	if(src_rx && due_rx <= host_irq_points)
+	{
+		latency(due_rx);
+		UDR0 = rx_next++;
+		USART0_RX_vect();
+		rx_sent++;
+		due_rx = host_irq_points + 1 + rnd(30);
+	}
+
+	host_uart();
+}
+
+//Main context: UI loop handling knob detents one by one
+void test_knob(void)
+{
+	long acked = 0;
+	int t1, n;
+
+	src_enc = 1;
+	due_enc = host_irq_points;
+	for(t1 = 0; t1 < STEPS; t1++)
+	{
+		n = knob_get();
+		host_irq_point(); //Instruction between read and ack
+		if(n >= 1)
+		{
+			knob_ack(1);
+			acked++;
+		}
+		else if(n <= -1)
+		{
+			knob_ack(-1);
+			acked--;
+		}
+		CHECK(knob_get() <= KNOB_MAX && knob_get() >= -KNOB_MAX);
+	}
+	src_enc = 0;
+	CHECK(enc_sum == acked + knob_get());
+	printf("knob: %lu edges, %ld detents counted, %ld acked, %d pending\n", enc_accepted, enc_sum, acked, knob_get());
+}
+
+//Main context: Time base must never go backwards or skip
+void test_ms(void)
+{
+	unsigned long last = get_ms(), now, t0 = get_ms(), ticks0 = ticks;
+	int t1;
+
+	for(t1 = 0; t1 < STEPS; t1++)
+	{
+		now = get_ms();
+		CHECK(now >= last);
+		last = now;
+		host_irq_point();
+	}
+	CHECK(get_ms() - t0 == ticks - ticks0);
+}
+
+//Main context: RX bytes arrive complete and in order, or are counted as lost
+void test_rx(void)
+{
+	unsigned char expect = 0;
+	unsigned long got = 0, lost = uart_rx_lost;
+	int t1, ch;
+
+	src_rx = 1;
+	due_rx = host_irq_points;
+	for(t1 = 0; t1 < STEPS; t1++)
+	{
+		while((ch = usart_receive()) >= 0)
+		{
+			if(ch != expect && uart_rx_lost != lost) //Ring was full: skip to next byte after the gap
+			{
+				lost = uart_rx_lost;
+				expect = ch;
+			}
+			CHECK(ch == expect);
+			expect++;
+			got++;
+		}
+		host_irq_point();
+		if(t1 % 97 == 0) //Busy main loop now and then
+		{
+			host_irq_point();
+			host_irq_point();
+		}
+	}
+	src_rx = 0;
+	printf("uart: %lu bytes sent, %lu received, %u lost\n", rx_sent, got, uart_rx_lost);
+}
+
+//Accessors called with interrupts off must not turn them on
+void test_cli(void)
+{
+	unsigned long t0;
+
+	cli();
+	t0 = ticks;
+	due_tick = host_irq_points; //Raised now, must wait for sei()
+	get_ms();
+	knob_get();
+	knob_ack(0);
+	get_adc(2);
+	get_s_dbm();
+	trace_put(TR_VFO, 0);
+	CHECK(!host_irq);
+	CHECK(ticks == t0);
+	sei();
+	CHECK(ticks == t0 + 1); //Pending interrupt taken at sei()
+}
+
+int main(void)
+{
+	host_init();
+	host_device = device;
+
+	test_knob();
+	test_ms();
+	test_rx();
+	test_cli();
+	CHECK(!irq_in_cli);
+	CHECK(trace_cnt <= TRACE_LEN);
+	printf("max. interrupt latency: %lu interrupt points\n", lat_max);
+
+	return host_result("test_isr");
+}
@@ -0,0 +1,85 @@
+//Key events of keys_task(): K2 acts on the release of a press it has seen itself,
+//the release of a K2 press that closed a menu must not save the frequency data.
+//ui_restore(): DDS1 back on the frequency of PTT state and split mode when a screen closes
+#include "host.h"
+
+//Last frequency set on DDS1, from the event trace
+long dds1(void)
+{
+	int t1;
+	unsigned char i;
+
+	for(t1 = 1; t1 <= TRACE_LEN; t1++)
+	{
+		i = (trace_head - t1) & (TRACE_LEN - 1);
+		if(trace_ev[i] == TR_DDS1)
+		{
+			return trace_arg[i];
+		}
+	}
+
+	return -1;
+}
+
+int main(void)
+{
+	unsigned long w;
+
+	host_init();
+	cur_band = 3;
+	f_vfo[0] = 14010000;
+	f_vfo[1] = 14020000;
+
+	//Menu returned on PRESS|2, RELEASE|2 is left in the queue
+	w = host_eeprom_writes;
+	host_tx_get();
+	key_put(KEY_EV_RELEASE | 2);
+	keys_task();
+	CHECK(host_eeprom_writes == w);
+	CHECK(!strcmp(host_tx_get(), ""));
+
+	//Long press only after a press seen by keys_task()
+	key_put(KEY_EV_LONG | 2);
+	keys_task();
+	key_put(KEY_EV_RELEASE | 2);
+	keys_task();
+	CHECK(host_eeprom_writes == w);
+
+	//Short K2 on the main screen
+	key_put(KEY_EV_PRESS | 2);
+	keys_task();
+	CHECK(host_eeprom_writes == w);
+	key_put(KEY_EV_RELEASE | 2);
+	keys_task();
+	CHECK(host_eeprom_writes > w);
+	CHECK(strstr(host_tx_get(), "COMM OK") != 0);
+
+	//Long K2: Quick store, release ignored
+	key_put(KEY_EV_PRESS | 2);
+	keys_task();
+	w = host_eeprom_writes;
+	key_put(KEY_EV_LONG | 2);
+	keys_task();
+	CHECK(host_eeprom_writes > w);
+	w = host_eeprom_writes;
+	host_tx_get();
+	key_put(KEY_EV_RELEASE | 2);
+	keys_task();
+	CHECK(host_eeprom_writes == w);
+	CHECK(!strcmp(host_tx_get(), ""));
+
+	//PTT pressed while a menu was open, split TX on B
+	split = 1;
+	vfo_s[0] = 1;
+	vfo_s[1] = 0;
+	txrx = 1;
+	set_frequency1(7000000); //Stale value of the screen
+	ui_restore();
+	CHECK(dds1() == 14020000);
+	txrx = 0;
+	ui_restore();
+	CHECK(dds1() == 14010000);
+	split = 0;
+
+	return host_result("test_keys");
+}
@@ -0,0 +1,55 @@
+//PA temperature and supply voltage: lookup/integer versions against the former floating point formulas
+//Full ADC range 0..1023
+#include "host.h"
+
+//Former show_temp() formula, 1/10 deg. C, clamped to the display range like get_temp10()
+int temp10_formula(int a)
+{
+	double r1 = 2000.0 / (1024.0 / a - 1);
+	int t = (int) (10.0 * (r1 - 1630) / 17.62);
+
+	if(t < TEMP_MIN)
+	{
+		t = TEMP_MIN;
+	}
+	if(t > TEMP_MAX)
+	{
+		t = TEMP_MAX;
+	}
+
+	return t;
+}
+
+//Former show_voltage() formula, 1/10 V
+int volts10_formula(int a)
+{
+	return (int) ((double) a * 5 / 1024 * 5 * 10);
+}
+
+int main(void)
+{
+	int a, d, dmax = 0;
+
+	host_init();
+
+	for(a = 0; a < 1024; a++)
+	{
+		adc_val[2] = a;
+		adc_val[3] = a;
+
+		d = abs(get_temp10() - temp10_formula(a));
+		if(d > dmax)
+		{
+			dmax = d;
+		}
+		if(d > 1)
+		{
+			printf("ADC %d: LUT %d, formula %d\n", a, get_temp10(), temp10_formula(a));
+		}
+		CHECK(d <= 1);
+		CHECK(get_volts10() == volts10_formula(a));
+	}
+	printf("temperature: max. deviation %d.%d deg. C\n", dmax / 10, dmax % 10);
+
+	return host_result("test_lut");
+}
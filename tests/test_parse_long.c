@@ -0,0 +1,99 @@
+//parse_long(): Random strings against a reference built on strtoll()
+//Accepted: optional sign, at least one digit, then end of string or ' ', saturated to +-2147483647
+#include "host.h"
+
+#define RUNS 2000000
+
+unsigned long rnd_state = 4711;
+
+unsigned int rnd(unsigned int n)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 16) % n;
+}
+
+//Returns -1 if malformed, else 0 and value
+int parse_ref(const char *s, long *val)
+{
+	const char *p = s;
+	long long v;
+
+	if(*p == '-' || *p == '+')
+	{
+		p++;
+	}
+	if(*p < '0' || *p > '9')
+	{
+		return -1;
+	}
+	while(*p >= '0' && *p <= '9')
+	{
+		p++;
+	}
+	if(*p && *p != ' ')
+	{
+		return -1;
+	}
+
+	v = strtoll(s, NULL, 10); //Saturates at LLONG_MIN/MAX
+	if(v > 2147483647)
+	{
+		v = 2147483647;
+	}
+	if(v < -2147483647)
+	{
+		v = -2147483647;
+	}
+	*val = v;
+
+	return 0;
+}
+
+void check(char *s)
+{
+	long v = 12345, ref = 12345;
+	int r, rr;
+
+	r = parse_long(s, &v);
+	rr = parse_ref(s, &ref);
+	CHECK(r == rr && v == ref);
+	if(r != rr || v != ref)
+	{
+		printf("\"%s\": %d %ld, expected %d %ld\n", s, r, v, rr, ref);
+	}
+}
+
+int main(void)
+{
+	const char alpha[] = "0123456789+- .E\tx";
+	const char digits[] = "0123456789";
+	char s[32];
+	int t1, t2, len;
+	char *fixed[] = {"", "-", "+", " ", "0", "-0", "+0", "00000000000000000000007", "2147483647", "2147483648",
+	                 "-2147483647", "-2147483648", "99999999999999999999", "14.2E6", "14200000 ", "1 2", "--1", "+-1", "1-"};
+
+	host_init();
+
+	for(t1 = 0; t1 < sizeof(fixed) / sizeof(fixed[0]); t1++)
+	{
+		strcpy(s, fixed[t1]);
+		check(s);
+	}
+
+	for(t1 = 0; t1 < RUNS; t1++)
+	{
+		len = rnd(16);
+		for(t2 = 0; t2 < len; t2++)
+		{
+			s[t2] = (t1 & 1) ? digits[rnd(10)] : alpha[rnd(sizeof(alpha) - 1)];
+		}
+		if(t1 & 2 && len)
+		{
+			s[0] = "+- 0"[rnd(4)];
+		}
+		s[len] = 0;
+		check(s);
+	}
+
+	return host_result("test_parse_long");
+}
@@ -0,0 +1,54 @@
+//Event trace: Dump of the firmware ("GET TRACE") through the host decoder
+#define TRACE_DECODE_TEST
+#include "trace_decode.c"
+
+int main(void)
+{
+	char *line, *next, out[128];
+	int n = 0;
+	const char *expect[] = {"       0 ms  TX on (CAT)",
+	                        "      10 ms  Band 3 (while TX)",
+	                        "      10 ms  VFO B",
+	                        "    1010 ms  DDS1 14195000 Hz",
+	                        "    1011 ms  CAT SET FRE...",
+	                        "    1011 ms  CAT Kenwood FA0;",
+	                        "    1012 ms  CAT binary frame SEQ 7 LEN 2 op 0x83",
+	                        "    1012 ms  EEPROM write at 607, value 1",
+	                        "    1012 ms  EEPROM write of frequency 144300000 Hz",
+	                        "    1012 ms  TX off (PTT)"};
+
+	host_init();
+	host_ms(65000);
+	trace_put(TR_TX, TR_TX_CAT | 1);
+	host_ms(10);
+	trace_put(TR_BAND, 3 | 0x100);
+	trace_put(TR_VFO, 1);
+	host_ms(1000); //16 bit time stamp wraps
+	trace_put(TR_DDS1, 14195000);
+	host_ms(1);
+	trace_put(TR_CAT, ((unsigned long) 'S' << 24) | ((unsigned long) 'F' << 16) | ('R' << 8) | 'E');
+	trace_put(TR_CAT, ((unsigned long) 'F' << 24) | ((unsigned long) 'A' << 16) | ('0' << 8) | ';');
+	host_ms(1);
+	trace_put(TR_CAT, ((unsigned long) CATB_SYNC << 24) | (7UL << 16) | (2 << 8) | 0x83);
+	TRACE_EEPROM(CAT_MODE_ADR, 1);
+	store_frequency1(144300000, 0);
+	trace_put(TR_TX, TR_TX_PTT);
+
+	trace_dump();
+	for(line = host_tx_get(); *line; line = next)
+	{
+		next = strchr(line, '\n');
+		*next++ = 0;
+		CHECK(trace_decode(line, out, sizeof(out)));
+		CHECK(n < 10 && !strcmp(out, expect[n]));
+		if(n < 10 && strcmp(out, expect[n]))
+		{
+			printf("got    \"%s\"\nexpect \"%s\"\n", out, expect[n]);
+		}
+		n++;
+	}
+	CHECK(n == 10);
+	CHECK(!trace_decode("TRACE.", out, sizeof(out)));
+
+	return host_result("test_trace");
+}
@@ -0,0 +1,106 @@
+//Decoder for the event trace dump ("GET TRACE"), usage: trace_decode.host < dump.txt
+//Lines "tttt ee aaaaaaaa" (hex) are printed as time since the first event and plain text,
+//other lines (echo, messages) are skipped. Event codes are taken from the firmware source.
+//Time stamps are 16 bit ms, events more than 65s apart give a wrong time difference.
+#include "host.h"
+
+unsigned long dec_t;   //ms since first event
+int dec_ms0 = -1;      //Time stamp of previous event
+
+//Printable char of TR_CAT argument
+char dec_char(unsigned long arg, int n)
+{
+	int ch = (arg >> (n * 8)) & 0xFF;
+
+	return (ch >= ' ' && ch < 127) ? ch : '.';
+}
+
+//Decode one dump line into out, returns 0 if it is not an event
+int trace_decode(const char *line, char *out, int len)
+{
+	unsigned int ms, ev;
+	unsigned long arg;
+	char *p;
+	static const char *tx_src[] = {"PTT", "CAT", "local"};
+	static const char *vfo_name[] = {"A", "B"};
+
+	if(sscanf(line, "%4x %2x %8lx", &ms, &ev, &arg) != 3 || strlen(line) < 16)
+	{
+		return 0;
+	}
+
+	if(dec_ms0 >= 0)
+	{
+		dec_t += (ms - dec_ms0) & 0xFFFF;
+	}
+	dec_ms0 = ms;
+
+	p = out + snprintf(out, len, "%8lu ms  ", dec_t);
+	len -= p - out;
+
+	switch(ev)
+	{
+		case TR_TX:
+			snprintf(p, len, "TX %s (%s)", (arg & 1) ? "on" : "off", ((arg >> 8) & 0xFF) < 3 ? tx_src[(arg >> 8) & 0xFF] : "?");
+			break;
+		case TR_BAND:
+			snprintf(p, len, "Band %lu%s", arg & 0xFF, (arg & 0x100) ? " (while TX)" : "");
+			break;
+		case TR_VFO:
+			snprintf(p, len, "VFO %s%s", vfo_name[arg & 1], (arg & 0x100) ? " (while TX)" : "");
+			break;
+		case TR_SIDEBAND:
+			snprintf(p, len, "Sideband %s", arg ? "USB" : "LSB");
+			break;
+		case TR_DDS1:
+			snprintf(p, len, "DDS1 %lu Hz", arg);
+			break;
+		case TR_DDS2:
+			snprintf(p, len, "DDS2 %lu Hz", arg);
+			break;
+		case TR_CAT:
+			if((arg >> 24) == CATB_SYNC)
+			{
+				snprintf(p, len, "CAT binary frame SEQ %lu LEN %lu op 0x%02lX", (arg >> 16) & 0xFF, (arg >> 8) & 0xFF, arg & 0xFF);
+			}
+			else if((arg & 0xFF) == ';')
+			{
+				snprintf(p, len, "CAT Kenwood %c%c%c;", dec_char(arg, 3), dec_char(arg, 2), dec_char(arg, 1));
+			}
+			else
+			{
+				snprintf(p, len, "CAT %cET %c%c%c...", dec_char(arg, 3), dec_char(arg, 2), dec_char(arg, 1), dec_char(arg, 0));
+			}
+			break;
+		case TR_UART_OVR:
+			snprintf(p, len, "UART overrun, %lu so far", arg);
+			break;
+		case TR_EEPROM:
+			snprintf(p, len, "EEPROM write at %lu, value %lu", arg >> 16, arg & 0xFFFF);
+			break;
+		case TR_EEPROM_FREQ:
+			snprintf(p, len, "EEPROM write of frequency %lu Hz", arg);
+			break;
+		default:
+			snprintf(p, len, "Event 0x%02X, 0x%08lX", ev, arg);
+	}
+
+	return 1;
+}
+
+#ifndef TRACE_DECODE_TEST
+int main(void)
+{
+	char line[128], out[128];
+
+	while(fgets(line, sizeof(line), stdin))
+	{
+		if(trace_decode(line, out, sizeof(out)))
+		{
+			puts(out);
+		}
+	}
+
+	return 0;
+}
+#endif
@@ -0,0 +1,15 @@
+//Host test build: ATOMIC_BLOCK clears the modelled I flag and restores it on every way out of the block
+//Pending interrupts are run by host.c when the flag is set again, like on the AVR
+#ifndef HOST_UTIL_ATOMIC_H
+#define HOST_UTIL_ATOMIC_H
+
+unsigned char host_atomic_begin(unsigned char);
+void host_atomic_end(unsigned char*);
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 1
+
+#define ATOMIC_BLOCK(type) for(unsigned char host_sreg __attribute__ ((cleanup (host_atomic_end))) = host_atomic_begin(type), \
+                               host_once = 1; host_once; host_once = 0)
+
+#endif
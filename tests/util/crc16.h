@@ -0,0 +1,9 @@
+//Host test build: CRC functions of avr-libc, bitwise versions in host.c
+#ifndef HOST_UTIL_CRC16_H
+#define HOST_UTIL_CRC16_H
+
+#include <stdint.h>
+
+uint16_t _crc_xmodem_update(uint16_t, uint8_t);
+
+#endif
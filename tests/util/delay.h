@@ -0,0 +1,8 @@
+//Host test build: delays are poll points of the simulation (host_poll())
+#ifndef HOST_UTIL_DELAY_H
+#define HOST_UTIL_DELAY_H
+
+void _delay_ms(double);
+void _delay_us(double);
+
+#endif